@@ -5,31 +5,14 @@
 #include <string>
 #include <filesystem>
 #include <vector>
+#include <iosfwd>
+#include <functional>
+#include "FileList.h"
+#include "IoBackend.h"
 
 namespace fs = std::filesystem;
 
-// 定义文件类型
-enum class FileType {
-    REGULAR,    // 普通文件
-    DIRECTORY,  // 目录
-    SYMLINK,    // 软链接
-    OTHER       // 其他
-};
-
-// 定义文件记录结构
-struct FileRecord {
-    std::string relPath;    // 相对路径
-    std::string absPath;    // 绝对路径
-    FileType type;          // 类型
-    uint64_t size;          // 大小 (或链接长度)
-    std::string linkTarget; // 软链接指向的目标
-
-    // --- 元数据 ---
-    uint32_t mode = 0;   // 权限
-    int64_t mtime = 0;   // 修改时间 (时间戳)
-    uint32_t uid = 0;    // 用户ID
-    uint32_t gid = 0;    // 组ID
-};
+class ThreadPool;
 
 // [新增] 加密模式枚举
 enum class EncryptionMode {
@@ -38,10 +21,11 @@ enum class EncryptionMode {
     RC4   // RC4 流密码 (算法2 - 进阶)
 };
 
-// 压缩模式枚举
+// 压缩模式枚举 (压缩结果不比原文时该条目自动退回原样存储)
 enum class CompressionMode {
     NONE,
-    RLE
+    RLE,  // 所有文件都尝试 RLE
+    AUTO  // 按扩展名 + 采样熵逐个条目挑选 codec
 };
 
 struct FilterOptions {
@@ -66,32 +50,181 @@ struct FilterOptions {
     int targetUid = -1;
 };
 
+// 分块校验的推荐块大小，块大小必须是 4 KiB 的整数倍
+constexpr uint32_t DEFAULT_CHECKSUM_BLOCK = 1 << 20;
+
+// 打包选项
+struct PackOptions {
+    // 整文件去重: 相同内容只存第一份，后续同内容文件只写一个引用条目
+    bool dedup = false;
+
+    // 分块校验: 每个条目的数据按此大小分块记录 CRC32C，条目头另记一个 CRC32C，0 表示不启用
+    uint32_t checksumBlockSize = 0;
+
+    // 差量打包: 基准包路径 (使用同一个密码)，同路径文件只存相对基准的差量，空表示不启用。
+    // 基准包必须是完整包: 差量包不能再做基准 (会报错)，定期备份应每次都对最近的完整包做差量
+    std::string baseArchive;
+
+    // 读取源文件的 I/O 后端 (小文件批量读)
+    IoBackendKind ioBackend = IoBackendKind::AUTO;
+
+    // 分卷: 每卷最多这么多字节，输出 <pck>.001、<pck>.002 ...，0 表示单文件
+    uint64_t volumeSize = 0;
+
+    // 分卷轮流写到这些目录 (各自一个写线程)，空表示都写在包路径所在目录
+    std::vector<std::string> volumeDirs;
+
+    // 每个写线程最多积压的字节数，0 表示一整卷 (不超过 64 MiB)。
+    // 打包线程交完当前卷才能开始下一卷，队列越小相邻两卷同时落盘的时间越短
+    uint64_t volumeQueueSize = 0;
+};
+
+// 打包统计
+struct PackStats {
+    int items = 0;
+    int dedupRefs = 0;        // 写成引用条目的文件数
+    uint64_t dedupBytes = 0;  // 因去重省下的原始字节数
+    int deltaEntries = 0;     // 写成差量条目的文件数
+    uint64_t deltaBytes = 0;  // 因差量省下的原始字节数
+    int compressedEntries = 0; // 实际以压缩形式存储的条目数
+};
+
+// 内存中的一个条目 (内存打包的输入 / 内存解包交给 visitor 的结果)
+struct MemoryEntry {
+    std::string relPath;
+    FileType type = FileType::REGULAR;
+    const char* data = nullptr; // 文件内容或链接目标，不拷贝，只在调用期间有效
+    uint64_t size = 0;
+
+    uint32_t mode = 0644;
+    int64_t mtime = 0;
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+};
+
+// 内存打包的输出回调: 按顺序收到包的每一段字节
+using PackSink = std::function<void(const char* data, size_t size)>;
+
+// 内存解包的条目回调: 去重条目的 data 指向首份内容
+using UnpackVisitor = std::function<void(const MemoryEntry& entry)>;
+
+// 解包选项
+struct UnpackOptions {
+    // 大于等于该大小的文件走 O_DIRECT 写入 (绕过页缓存)，0 表示不启用
+    uint64_t directIoMinSize = 0;
+
+    // 差量包的基准包路径 (使用同一个密码)，即打包时 -base 指定的完整包
+    std::string baseArchive;
+
+    // 写出文件的 I/O 后端 (小文件批量写)
+    IoBackendKind ioBackend = IoBackendKind::AUTO;
+
+    // 分卷包除了包路径所在目录，还到这些目录里找分卷 (基准包同样适用)
+    std::vector<std::string> volumeDirs;
+};
+
+// 镜像恢复选项
+struct RestoreOptions {
+    // 差异恢复: 只覆盖与目标不同的文件 (大小 -> mtime -> CRC 逐级比较)，并把目标 mtime 对齐到镜像
+    bool differential = false;
+
+    // 差异恢复时删除目标里镜像没有的文件/目录
+    bool deleteExtra = false;
+
+    // 比较/复制的并发数，0 表示用引擎配置
+    unsigned threads = 0;
+};
+
+// 日志
+enum class LogLevel {
+    INFO,  // 进度
+    ERROR  // 条目级错误 (CRC 不符、抢救等)，不中断任务
+};
+using EngineLogger = std::function<void(LogLevel level, const std::string& message)>;
+
+// 打包统计回调: 每次 pack / packMemory 完成后调用一次
+using StatsSink = std::function<void(const PackStats& stats)>;
+
+// 引擎实例配置。每个任务一个引擎实例，实例之间互不共享可变状态
+struct EngineConfig {
+    // 共享线程池 (包校验、批量 I/O 用)，由调用方持有且生命周期长于引擎；
+    // 为空时每次调用临时建一个 threads 大小的池。不要在该池的任务里再调用引擎方法
+    ThreadPool* pool = nullptr;
+    unsigned threads = 0; // 0 表示按 CPU 核数
+
+    // stdin/stdout 流式读写的缓冲块大小
+    size_t ioBufferSize = 1 << 20;
+
+    // 为空时 INFO 写 std::cout，ERROR 写 std::cerr (包数据占用 stdout 时 INFO 也写 std::cerr)
+    EngineLogger logger;
+    StatsSink statsSink;
+};
+
+// 所有方法都是 const 的，不修改实例，同一实例也可以被多个线程同时调用
 class BackupEngine {
 public:
+    explicit BackupEngine(EngineConfig config = EngineConfig());
+
+    const EngineConfig& getConfig() const { return config; }
+
     // === 基础功能 ===
-    static void backup(const std::string& srcPath, const std::string& destPath);
-    static std::string verify(const std::string& dest);
-    static void restore(const std::string& srcPath, const std::string& destPath);
+    void backup(const std::string& srcPath, const std::string& destPath) const;
+    std::string verify(const std::string& dest) const;
+
+    // 包校验: 不解包，分块 CRC 多线程核对 (threads 为 0 时用配置)，返回空串表示通过
+    std::string verifyPack(const std::string& packFile, const std::string& password = "",
+                           unsigned threads = 0) const;
+    void restore(const std::string& srcPath, const std::string& destPath,
+                 const RestoreOptions& opts = RestoreOptions()) const;
 
     // === 扩展功能：打包/解包 (含加密) ===
 
     // pack: 支持指定密码和加密模式
-    static void pack(const std::string& srcPath, const std::string& outputFile,
-                     const std::string& password = "",
-                     EncryptionMode encMode = EncryptionMode::NONE,
-                     const FilterOptions& filter = FilterOptions(),
-                     CompressionMode compMode = CompressionMode::NONE); // 默认全选
+    // outputFile 为 "-" 时写到 stdout (流式格式，带结束标记，全程无回退 seek)
+    // opts.volumeSize 非 0 时按卷切分 (同样是流式格式)
+    void pack(const std::string& srcPath, const std::string& outputFile,
+              const std::string& password = "",
+              EncryptionMode encMode = EncryptionMode::NONE,
+              const FilterOptions& filter = FilterOptions(),
+              CompressionMode compMode = CompressionMode::NONE, // 默认全选
+              const PackOptions& opts = PackOptions()) const;
+
+    // === 内存打包/解包 (不经过文件系统) ===
+
+    // packMemory: 把 entries 编码成包 (流式格式)，字节依次交给 sink。
+    // opts.baseArchive 可用 (基准包从文件读取)；不支持分卷 (volumeSize 非 0 时抛异常)
+    PackStats packMemory(const std::vector<MemoryEntry>& entries, const PackSink& sink,
+                         const std::string& password = "",
+                         EncryptionMode encMode = EncryptionMode::NONE,
+                         CompressionMode compMode = CompressionMode::NONE,
+                         const PackOptions& opts = PackOptions()) const;
+
+    // unpackMemory: 直接解析 [data, data + size) 中的包，每个条目回调一次 visitor
+    void unpackMemory(const char* data, size_t size, const UnpackVisitor& visitor,
+                      const std::string& password = "") const;
 
     // unpack: 只需要密码，模式由文件头自动识别
-    static void unpack(const std::string& packFile, const std::string& destPath,
-                       const std::string& password = "");
+    // 有受损条目时能抢救的照常写出，最后仍抛异常，调用方据此区分抢救结果和完整还原
+    // packFile 为 "-" 时从 stdin 读取；packFile 不存在 (或以 .001 结尾) 时按分卷包读取
+    void unpack(const std::string& packFile, const std::string& destPath,
+                const std::string& password = "",
+                const UnpackOptions& opts = UnpackOptions()) const;
 
 private:
+    EngineConfig config;
+
     // 内部辅助函数
-    static std::vector<FileRecord> scanDirectory(const std::string& sourcePath, const FilterOptions& filter);
-    static void packFiles(const std::vector<FileRecord>& files, const std::string& outputFile,
-                          const std::string& password, EncryptionMode encMode,
-                          CompressionMode compMode);
+    // stdoutBusy: stdout 正在输出包数据，默认 logger 的 INFO 也改写 stderr
+    EngineLogger logger(bool stdoutBusy = false) const;
+    static FileList scanDirectory(const std::string& sourcePath, const FilterOptions& filter);
+    void restoreDifferential(const fs::path& backupDir, const fs::path& targetDir,
+                             const RestoreOptions& opts) const;
+    PackStats packFiles(const FileList& files, std::ostream& out,
+                        const std::string& password, EncryptionMode encMode,
+                        CompressionMode compMode, const PackOptions& opts,
+                        bool streamMode) const;
+    void unpackStream(std::istream& in, const std::string& destPath,
+                      const std::string& password, const UnpackOptions& opts) const;
 };
 
 #endif //MINIBACKUP_BACKUPENGINE_H
\ No newline at end of file
@@ -10,21 +10,35 @@
 #include <iomanip>
 #include <sstream>
 #include <filesystem> // [新增]
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+    #define MINIBACKUP_CRC32C_HW 1
+#endif
 
 class CRC32 {
-public:
-    // 计算内存数据的 CRC32
-    static uint32_t calculate(const char* data, size_t size) {
-        uint32_t crc = 0xFFFFFFFF;
-        for (size_t i = 0; i < size; ++i) {
-            auto byte = static_cast<uint8_t>(data[i]);
-            crc ^= byte;
-            for (int j = 0; j < 8; ++j) {
-                constexpr uint32_t polynomial = 0xEDB88320;
-                uint32_t mask = -static_cast<int>(crc & 1);
-                crc = (crc >> 1) ^ (polynomial & mask);
+    static const uint32_t (&table())[256] {
+        static uint32_t t[256];
+        static bool ready = [] {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320 & (0u - (c & 1)));
+                t[n] = c;
             }
-        }
+            return true;
+        }();
+        (void)ready;
+        return t;
+    }
+
+public:
+    // 计算内存数据的 CRC32，可分段累加: crc 传入上一段的返回值
+    static uint32_t calculate(const char* data, size_t size, uint32_t crc = 0) {
+        const auto& t = table();
+        const auto* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+        while (size-- > 0) crc = (crc >> 8) ^ t[(crc ^ *p++) & 0xFF];
         return ~crc;
     }
 
@@ -37,20 +51,11 @@ public:
         if (!file.is_open()) return "00000000";
 
         char buffer[4096];
-        uint32_t crc = 0xFFFFFFFF;
+        uint32_t crc = 0;
 
         while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-            for (std::streamsize i = 0; i < file.gcount(); ++i) {
-                auto byte = static_cast<uint8_t>(buffer[i]);
-                crc ^= byte;
-                for (int j = 0; j < 8; ++j) {
-                    constexpr uint32_t polynomial = 0xEDB88320;
-                    uint32_t mask = -static_cast<int>(crc & 1);
-                    crc = (crc >> 1) ^ (polynomial & mask);
-                }
-            }
+            crc = calculate(buffer, static_cast<size_t>(file.gcount()), crc);
         }
-        crc = ~crc;
 
         std::stringstream ss;
         ss << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << crc;
@@ -58,4 +63,76 @@ public:
     }
 };
 
+// CRC32C (Castagnoli)，用于分块校验
+// 支持 SSE4.2 的 CPU 走 crc32 指令，否则走 slicing-by-8 查表
+class CRC32C {
+    static const uint32_t (&table())[8][256] {
+        static uint32_t t[8][256];
+        static bool ready = [] {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78 & (0u - (c & 1)));
+                t[0][n] = c;
+            }
+            for (uint32_t n = 0; n < 256; ++n) {
+                for (int k = 1; k < 8; ++k) t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xFF];
+            }
+            return true;
+        }();
+        (void)ready;
+        return t;
+    }
+
+    static uint32_t software(uint32_t crc, const unsigned char* p, size_t size) {
+        const auto& t = table();
+        while (size >= 8) {
+            uint32_t lo, hi;
+            std::memcpy(&lo, p, 4);
+            std::memcpy(&hi, p + 4, 4);
+            lo ^= crc;
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+            p += 8;
+            size -= 8;
+        }
+        while (size-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        return crc;
+    }
+
+#ifdef MINIBACKUP_CRC32C_HW
+    __attribute__((target("sse4.2")))
+    static uint32_t hardware(uint32_t crc, const unsigned char* p, size_t size) {
+#if defined(__x86_64__)
+        uint64_t c = crc;
+        while (size >= 8) {
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            c = _mm_crc32_u64(c, v);
+            p += 8;
+            size -= 8;
+        }
+        crc = static_cast<uint32_t>(c);
+#endif
+        while (size-- > 0) crc = _mm_crc32_u8(crc, *p++);
+        return crc;
+    }
+
+    static bool hasHardware() {
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+    }
+#endif
+
+public:
+    // 可分段累加: crc 传入上一段的返回值
+    static uint32_t calculate(const char* data, size_t size, uint32_t crc = 0) {
+        const auto* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+#ifdef MINIBACKUP_CRC32C_HW
+        if (hasHardware()) return ~hardware(crc, p, size);
+#endif
+        return ~software(crc, p, size);
+    }
+};
+
 #endif //MINIBACKUP_CRC32_H
\ No newline at end of file
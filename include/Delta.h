@@ -0,0 +1,37 @@
+// include/Delta.h
+#ifndef MINIBACKUP_DELTA_H
+#define MINIBACKUP_DELTA_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Hash128.h"
+
+// rsync 式差量编码
+// 基准文件按固定块切分，每块记录 滚动校验 (Adler 式, 32 位) + 强哈希 (Hash128)。
+// 新文件逐字节滑动窗口，滚动校验命中再比强哈希，命中的块输出 "从基准拷贝"，其余输出 "字面量"。
+//
+// 指令流格式 (小端):
+//   uint64 targetSize
+//   { uint8 op = DELTA_OP_COPY,    uint64 baseOffset, uint64 length }
+//   { uint8 op = DELTA_OP_LITERAL, uint64 length, bytes[length] }
+
+constexpr uint8_t DELTA_OP_COPY = 1;
+constexpr uint8_t DELTA_OP_LITERAL = 2;
+
+struct DeltaSignature {
+    uint32_t blockSize = 0;
+    uint64_t fileSize = 0;
+    std::vector<uint32_t> weak;       // 每个完整块的滚动校验 (尾部不足一块的部分不参与匹配)
+    std::vector<Hash128Value> strong; // 每个完整块的强哈希
+
+    static DeltaSignature build(const char* data, size_t size);
+};
+
+// 生成指令流；差量不划算 (接近原文件大小) 时返回 false，调用方应整文件存储
+bool computeDelta(const DeltaSignature& sig, const char* data, size_t size, std::vector<char>& out);
+
+// 按指令流从 base 重建文件，指令越界时抛异常
+void applyDelta(const char* base, size_t baseSize, const char* delta, size_t deltaSize, std::vector<char>& out);
+
+#endif //MINIBACKUP_DELTA_H
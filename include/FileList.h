@@ -0,0 +1,124 @@
+// include/FileList.h
+#ifndef MINIBACKUP_FILELIST_H
+#define MINIBACKUP_FILELIST_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <array>
+#include <map>
+
+// 定义文件类型
+enum class FileType {
+    REGULAR,    // 普通文件
+    DIRECTORY,  // 目录
+    SYMLINK,    // 软链接
+    OTHER       // 其他
+};
+
+// 定义文件记录结构
+struct FileRecord {
+    std::string relPath;    // 相对路径
+    std::string absPath;    // 绝对路径
+    FileType type;          // 类型
+    uint64_t size;          // 大小 (或链接长度)
+    std::string linkTarget; // 软链接指向的目标
+
+    // --- 元数据 ---
+    uint32_t mode = 0;   // 权限
+    int64_t mtime = 0;   // 修改时间 (时间戳)
+    uint32_t uid = 0;    // 用户ID
+    uint32_t gid = 0;    // 组ID
+};
+
+// 紧凑的扫描结果 (千万级文件用)
+// - 路径按 "父节点下标 + 文件名" 驻留在一块连续的名字区里，不再为每条记录分配两个 std::string
+// - 记录的各字段按列 (struct-of-arrays) 存放；名字区用 32 位偏移 (上限 4 GiB)
+// - mode/uid/gid 组合很少 (扫描器目前固定写 0644/0/0)，只存一份，记录里放 4 字节编号
+// - relPath / absPath 只在迭代取出时临时拼出
+// 迭代器解引用得到 const FileRecord&，调用方写法与 std::vector<FileRecord> 相同
+class FileList {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    // rootPath: 所有节点共同的上级绝对路径 (absPath = rootPath + 分隔符 + relPath)
+    explicit FileList(std::string rootPath = "");
+
+    // 驻留一个路径节点 (目录即使被筛掉也要作为父节点登记)
+    uint32_t addNode(uint32_t parent, const std::string& name);
+
+    // 以 node 为路径追加一条记录，元数据取自 rec (rec 的路径字段被忽略)
+    void add(uint32_t node, const FileRecord& rec);
+
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+
+    std::string relPath(size_t index) const;
+    std::string absPath(size_t index) const;
+
+    // 把第 index 条记录展开到 out (复用 out 里字符串已有的容量)
+    void fill(size_t index, FileRecord& out) const;
+
+    // 解引用返回迭代器自身缓存的记录 (stashing iterator)，拷贝或前进后引用即失效，
+    // 所以只能算输入迭代器；需要保留的记录请自行拷贝
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = FileRecord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const FileRecord*;
+        using reference = const FileRecord&;
+
+        const_iterator(const FileList* list, size_t index) : list(list), index(index) {}
+
+        reference operator*() const { list->fill(index, current); return current; }
+        pointer operator->() const { return &**this; }
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++index; return tmp; }
+        bool operator==(const const_iterator& o) const { return index == o.index; }
+        bool operator!=(const const_iterator& o) const { return index != o.index; }
+
+    private:
+        const FileList* list;
+        size_t index;
+        mutable FileRecord current{}; // 解引用时就地展开
+    };
+
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+
+private:
+    std::string rootPath;
+
+    // 路径节点 (struct-of-arrays)
+    std::vector<char> nameArena;
+    std::vector<uint32_t> nodeNameOff;
+    std::vector<uint16_t> nodeNameLen;
+    std::vector<uint32_t> nodeParent;
+
+    // 记录 (struct-of-arrays)
+    std::vector<uint32_t> nodes;
+    std::vector<uint8_t> types;
+    std::vector<uint64_t> sizes;
+    std::vector<int64_t> mtimes;
+    std::vector<uint32_t> ownerIds;
+
+    // 去重后的 {mode, uid, gid}
+    using Owner = std::array<uint32_t, 3>;
+    std::vector<Owner> owners;
+    std::map<Owner, uint32_t> ownerIndex;
+    uint32_t lastOwner = UINT32_MAX; // 连续记录多半相同，先比上一条
+
+    // 软链接目标很少见，单独稀疏存放: 记录下标 -> 名字区偏移
+    std::vector<uint32_t> linkRecords;
+    std::vector<uint32_t> linkOff;
+    std::vector<uint32_t> linkLen;
+
+    void appendRelPath(uint32_t node, std::string& out) const;
+    uint32_t appendName(const std::string& name); // 写入名字区，返回偏移
+    uint32_t internOwner(const FileRecord& rec);
+};
+
+#endif //MINIBACKUP_FILELIST_H
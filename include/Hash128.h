@@ -0,0 +1,110 @@
+// include/Hash128.h
+
+#ifndef MINIBACKUP_HASH128_H
+#define MINIBACKUP_HASH128_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+struct Hash128Value {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const Hash128Value& o) const { return low == o.low && high == o.high; }
+    bool operator!=(const Hash128Value& o) const { return !(*this == o); }
+
+    std::string toHex() const {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(16) << high << std::setw(16) << low;
+        return ss.str();
+    }
+};
+
+struct Hash128ValueHasher {
+    size_t operator()(const Hash128Value& v) const { return static_cast<size_t>(v.low ^ (v.high * 0x9E3779B97F4A7C15ULL)); }
+};
+
+// 128 位快速内容哈希 (xxh3 同类: 64 位乘法折叠 + 多路累加)
+// 用于去重这类需要强区分度的场景，不是密码学哈希
+class Hash128 {
+    static constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    // 64x64 -> 128 乘法后高低位异或折叠
+    static uint64_t mulFold(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        uint64_t hi;
+        uint64_t lo = _umul128(a, b, &hi);
+        return lo ^ hi;
+#else
+        uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+        uint64_t bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+        uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+        uint64_t cross = (ll >> 32) + (lh & 0xFFFFFFFF) + hl;
+        uint64_t hi = hh + (lh >> 32) + (cross >> 32);
+        uint64_t lo = (cross << 32) | (ll & 0xFFFFFFFF);
+        return lo ^ hi;
+#endif
+    }
+
+    static uint64_t avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= 0x165667919E3779F9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+public:
+    static Hash128Value calculate(const char* data, size_t size, uint64_t seed = 0) {
+        const auto* p = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* const end = p + size;
+
+        // 4 路累加，每轮吃 32 字节
+        uint64_t acc[4] = {seed + P1, seed ^ P2, seed + P3, seed ^ P4};
+        while (end - p >= 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                uint64_t v = read64(p + lane * 8);
+                acc[lane] = mulFold(acc[lane] ^ v, P5 + static_cast<uint64_t>(lane) * 2) + v;
+            }
+            p += 32;
+        }
+
+        // 尾部不足 32 字节：按 8 字节 / 单字节吸收
+        uint64_t tail = P5 ^ static_cast<uint64_t>(size);
+        while (end - p >= 8) {
+            tail = mulFold(tail ^ read64(p), P1);
+            p += 8;
+        }
+        while (p < end) {
+            tail = mulFold(tail ^ *p, P2);
+            ++p;
+        }
+
+        Hash128Value out;
+        out.low = avalanche(mulFold(acc[0] ^ acc[2], P3) + mulFold(acc[1] ^ tail, P4) + size);
+        out.high = avalanche(mulFold(acc[1] ^ acc[3], P2) + mulFold(acc[0] ^ tail, P1) + (size * P5));
+        return out;
+    }
+};
+
+#endif //MINIBACKUP_HASH128_H
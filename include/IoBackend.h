@@ -0,0 +1,59 @@
+// include/IoBackend.h
+#ifndef MINIBACKUP_IOBACKEND_H
+#define MINIBACKUP_IOBACKEND_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+struct EntryMeta;
+class ThreadPool;
+
+// I/O 后端选择
+enum class IoBackendKind {
+    AUTO,    // 优先 io_uring，不可用时退回线程池
+    URING,   // 只用 io_uring，不可用时同样退回线程池
+    THREADS, // 线程池并发做同步系统调用
+    SYNC     // 不批量，逐个文件 open/read/write/close (旧行为)
+};
+
+// 批量读: 整个文件读进 data
+struct ReadJob {
+    std::string path;
+    std::vector<char> data;
+    int error = 0; // errno，0 表示成功
+};
+
+// 批量写: 在 dirFd 目录下创建 name 并写入 data，随后回写元数据
+struct WriteJob {
+    int dirFd = -1;
+    std::string name;
+    const char* data = nullptr;
+    size_t size = 0;
+    const EntryMeta* meta = nullptr;
+    int error = 0; // errno，0 表示成功
+};
+
+// 小文件批量 I/O
+// 一次交出一批互不相关的文件，后端负责把 openat/statx/read/write/close 的往返合并或并发起来:
+// - io_uring: 每个阶段整批提交，一次 io_uring_enter 等全部完成
+// - 线程池: 把批次切片后各线程做同步系统调用
+// 单个文件失败只记在 job.error 里，不抛异常
+class IoBackend {
+public:
+    virtual ~IoBackend() = default;
+
+    virtual const char* name() const = 0;
+    virtual void readFiles(std::vector<ReadJob>& jobs) = 0;
+#ifndef _WIN32
+    virtual void writeFiles(std::vector<WriteJob>& jobs) = 0;
+#endif
+
+    // SYNC 返回 nullptr，调用方走逐文件的旧路径。
+    // pool 非空时线程池后端借用它 (调用方保证其生命周期)，否则自建 threads 大小的池
+    static std::unique_ptr<IoBackend> create(IoBackendKind kind = IoBackendKind::AUTO, unsigned threads = 0,
+                                             ThreadPool* pool = nullptr);
+};
+
+#endif //MINIBACKUP_IOBACKEND_H
@@ -0,0 +1,141 @@
+// include/PipeStream.h
+
+#ifndef MINIBACKUP_PIPESTREAM_H
+#define MINIBACKUP_PIPESTREAM_H
+
+#include <streambuf>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <unistd.h>
+#endif
+
+// 管道写入块大小：1 MiB，整块写出，ssh / nc 管道能跑满带宽
+constexpr size_t PIPE_CHUNK_SIZE = 1 << 20;
+
+// 把 stdin / stdout 切到二进制模式 (Linux 下无需处理)
+inline void setBinaryMode(int fd) {
+#ifdef _WIN32
+    _setmode(fd, _O_BINARY);
+#else
+    (void)fd;
+#endif
+}
+
+// 基于文件描述符的输出缓冲区 (用于 pack 到 stdout)
+// 只有攒满一整块才写出，偏移始终按 PIPE_CHUNK_SIZE 对齐，最后一块由 sync() 冲刷
+class FdOutBuf : public std::streambuf {
+    int fd;
+    std::vector<char> buffer;
+
+    void writeAll(const char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            int n = _write(fd, data, static_cast<unsigned int>(size));
+#else
+            ssize_t n = ::write(fd, data, size);
+#endif
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Pipe write failed: ") + std::strerror(errno));
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    void flushBuffer() {
+        writeAll(pbase(), static_cast<size_t>(pptr() - pbase()));
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        flushBuffer();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        std::streamsize done = 0;
+        while (done < n) {
+            // 缓冲区为空且剩余数据够一整块：直接整块写出，省一次拷贝
+            if (pptr() == pbase() && static_cast<size_t>(n - done) >= buffer.size()) {
+                size_t whole = (static_cast<size_t>(n - done) / buffer.size()) * buffer.size();
+                writeAll(s + done, whole);
+                done += static_cast<std::streamsize>(whole);
+                continue;
+            }
+            std::streamsize room = epptr() - pptr();
+            std::streamsize step = std::min(room, n - done);
+            std::memcpy(pptr(), s + done, static_cast<size_t>(step));
+            pbump(static_cast<int>(step));
+            done += step;
+            if (pptr() == epptr()) flushBuffer();
+        }
+        return n;
+    }
+
+    int sync() override {
+        flushBuffer();
+        return 0;
+    }
+
+public:
+    explicit FdOutBuf(int fd, size_t chunkSize = PIPE_CHUNK_SIZE) : fd(fd), buffer(chunkSize) {
+        setBinaryMode(fd);
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    ~FdOutBuf() override {
+        try { flushBuffer(); } catch (...) {}
+    }
+};
+
+// 基于文件描述符的输入缓冲区 (用于从 stdin 解包)
+class FdInBuf : public std::streambuf {
+    int fd;
+    std::vector<char> buffer;
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        for (;;) {
+#ifdef _WIN32
+            int n = _read(fd, buffer.data(), static_cast<unsigned int>(buffer.size()));
+#else
+            ssize_t n = ::read(fd, buffer.data(), buffer.size());
+#endif
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return traits_type::eof();
+            setg(buffer.data(), buffer.data(), buffer.data() + n);
+            return traits_type::to_int_type(*gptr());
+        }
+    }
+
+public:
+    explicit FdInBuf(int fd, size_t chunkSize = PIPE_CHUNK_SIZE) : fd(fd), buffer(chunkSize) {
+        setBinaryMode(fd);
+        setg(buffer.data(), buffer.data(), buffer.data());
+    }
+};
+
+// 只读内存输入缓冲区 (用于内存解包)，直接指向调用方的数据，不拷贝
+class SpanInBuf : public std::streambuf {
+public:
+    SpanInBuf(const char* data, size_t size) {
+        char* p = const_cast<char*>(data); // streambuf 接口要求非 const，读路径不会写入
+        setg(p, p, p + size);
+    }
+};
+
+#endif //MINIBACKUP_PIPESTREAM_H
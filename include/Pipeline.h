@@ -0,0 +1,246 @@
+// include/Pipeline.h
+#ifndef MINIBACKUP_PIPELINE_H
+#define MINIBACKUP_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "BackupEngine.h"
+#include "CRC32.h"
+
+// 包数据流水线
+// - 加解密是模板策略: 每个包只按包头选一次策略类型，之后所有字段/载荷都是静态分派，
+//   不再逐字段判断 encMode
+// - 载荷按 PIPELINE_CHUNK 分块，每块在缓存里一次走完 加解密 + CRC32C + CRC32，
+//   不再为每个阶段整条目扫一遍、拷一份
+// - codec 走运行时注册表 (条目级选择，按 ID 查表)，新增 codec/加密算法不用改 pack/unpack
+
+constexpr size_t PIPELINE_CHUNK = 64 << 10;
+
+// ==========================================
+// 加解密策略
+// ==========================================
+// 每个策略提供:
+//   MODE / MAGIC            对应的 EncryptionMode 与包头 magic
+//   Cipher(password)        password 保证非空 (空密码一律走 PlainCipher)
+//   apply(buf, size, off)   就地加解密；off 为本段在一次整体加密中的起始位置 (XOR 需要接上密钥下标)
+//   skip(size)              只推进密钥流 (校验时跳过载荷用)
+
+struct PlainCipher {
+    static constexpr EncryptionMode MODE = EncryptionMode::NONE;
+    static constexpr const char* MAGIC = "MINIBK10";
+
+    explicit PlainCipher(const std::string&) {}
+    void apply(char*, size_t, size_t = 0) {}
+    void skip(size_t) {}
+};
+
+class XorCipher {
+    std::string key;
+public:
+    static constexpr EncryptionMode MODE = EncryptionMode::XOR;
+    static constexpr const char* MAGIC = "MINIBK_X";
+
+    explicit XorCipher(const std::string& password) : key(password) {}
+    void apply(char* buffer, size_t size, size_t offset = 0) {
+        const size_t keyLen = key.size();
+        size_t k = offset % keyLen;
+        for (size_t n = 0; n < size; ++n) {
+            buffer[n] ^= key[k];
+            if (++k == keyLen) k = 0;
+        }
+    }
+    void skip(size_t) {}
+};
+
+// RC4 的密钥流贯穿整个包
+class Rc4Cipher {
+    unsigned char S[256]{};
+    uint8_t i = 0, j = 0;
+public:
+    static constexpr EncryptionMode MODE = EncryptionMode::RC4;
+    static constexpr const char* MAGIC = "MINIBK_R";
+
+    explicit Rc4Cipher(const std::string& key) {
+        for (int k = 0; k < 256; ++k) S[k] = static_cast<unsigned char>(k);
+        uint8_t jt = 0;
+        for (size_t it = 0; it < 256; ++it) {
+            jt = static_cast<uint8_t>(jt + S[it] + static_cast<unsigned char>(key[it % key.size()]));
+            std::swap(S[it], S[jt]);
+        }
+    }
+    void apply(char* buffer, size_t size, size_t = 0) {
+        for (size_t k = 0; k < size; ++k) {
+            ++i;
+            j = static_cast<uint8_t>(j + S[i]);
+            std::swap(S[i], S[j]);
+            buffer[k] ^= S[static_cast<uint8_t>(S[i] + S[j])];
+        }
+    }
+    void skip(size_t size) {
+        for (size_t k = 0; k < size; ++k) {
+            ++i;
+            j = static_cast<uint8_t>(j + S[i]);
+            std::swap(S[i], S[j]);
+        }
+    }
+};
+
+// 加密算法注册表: 新算法写一个策略类型加到这里即可
+template <class... Ciphers>
+struct CipherList {};
+using RegisteredCiphers = CipherList<PlainCipher, XorCipher, Rc4Cipher>;
+
+namespace pipeline_detail {
+
+template <class Fn, class First, class... Rest>
+decltype(auto) dispatchCipher(EncryptionMode mode, const std::string& password, Fn& fn, CipherList<First, Rest...>) {
+    if constexpr (sizeof...(Rest) == 0) {
+        if (First::MODE != mode) throw std::runtime_error("Unsupported encryption mode");
+        First cipher(password);
+        return fn(cipher);
+    } else {
+        if (First::MODE == mode) {
+            First cipher(password);
+            return fn(cipher);
+        }
+        return dispatchCipher(mode, password, fn, CipherList<Rest...>{});
+    }
+}
+
+template <class... Ciphers>
+bool modeFromMagic(const std::string& magic, EncryptionMode& mode, CipherList<Ciphers...>) {
+    return ((magic == Ciphers::MAGIC ? (mode = Ciphers::MODE, true) : false) || ...);
+}
+
+template <class... Ciphers>
+const char* magicOfMode(EncryptionMode mode, CipherList<Ciphers...>) {
+    const char* magic = nullptr;
+    ((Ciphers::MODE == mode ? (magic = Ciphers::MAGIC, true) : false) || ...);
+    if (!magic) throw std::runtime_error("Unsupported encryption mode");
+    return magic;
+}
+
+} // namespace pipeline_detail
+
+// 按模式构造一次策略对象，fn(cipher) 内的代码按具体策略类型实例化。空密码不加密
+template <class Fn>
+decltype(auto) withCipher(EncryptionMode mode, const std::string& password, Fn&& fn) {
+    if (password.empty()) mode = EncryptionMode::NONE;
+    return pipeline_detail::dispatchCipher(mode, password, fn, RegisteredCiphers{});
+}
+
+// 包头 magic <-> EncryptionMode；未知 magic 返回 false
+inline bool cipherFromMagic(const std::string& magic, EncryptionMode& mode) {
+    return pipeline_detail::modeFromMagic(magic, mode, RegisteredCiphers{});
+}
+inline const char* cipherMagic(EncryptionMode mode) {
+    return pipeline_detail::magicOfMode(mode, RegisteredCiphers{});
+}
+
+// ==========================================
+// codec 注册表
+// ==========================================
+
+// codec ID (与 compFlag 低位的取值一致)
+constexpr uint8_t PCK_CODEC_STORE = 0;
+constexpr uint8_t PCK_CODEC_RLE = 1;
+
+// 从条目头/中/尾各取一个窗口做的采样: 字节熵 (bit/byte) 和游程数
+struct CodecSample {
+    double entropy = 8.0;
+    uint64_t bytes = 0;
+    uint64_t runs = 0;
+};
+CodecSample sampleData(const char* data, size_t size);
+
+// 整条目编解码，结果写入 out (调用方保证 out 为空)。
+// STORE 的 encode/decode 为空，表示原样存储、不必经过额外的缓冲区。
+// estimate 估计编码结果占原文大小的比例，AUTO 模式按它在所有 codec 里挑最小的；为空则不参与自动挑选
+struct Codec {
+    uint8_t id = 0;
+    std::string name;
+    std::function<void(const char* data, size_t size, std::vector<char>& out)> encode;
+    std::function<void(const char* data, size_t size, std::vector<char>& out)> decode;
+    std::function<double(const CodecSample& sample, const char* data, size_t size)> estimate;
+};
+
+// 未注册的 ID 返回 nullptr
+const Codec* findCodec(uint8_t id);
+
+// 已注册的 codec，按 ID 升序
+const std::vector<const Codec*>& registeredCodecs();
+
+// 注册新 codec (ID 已占用时抛异常)。只应在启动阶段、打包/解包开始之前调用
+void registerCodec(const Codec& codec);
+
+// ==========================================
+// 分块单遍处理
+// ==========================================
+
+// 打包方向: 已编码的明文逐块 加密 -> 分块 CRC32C (落盘字节) -> emit
+// blockSize 为 0 时不生成分块表
+template <class Cipher, class Emit>
+void sealPayload(Cipher& cipher, char* data, size_t size, uint32_t blockSize,
+                 std::vector<uint32_t>& blockCRCs, Emit&& emit) {
+    blockCRCs.clear();
+    uint32_t blockCRC = 0;
+    size_t blockFill = 0;
+    for (size_t pos = 0; pos < size;) {
+        size_t n = std::min(PIPELINE_CHUNK, size - pos);
+        if (blockSize != 0) n = std::min<size_t>(n, blockSize - blockFill);
+
+        char* p = data + pos;
+        cipher.apply(p, n, pos);
+        if (blockSize != 0) {
+            blockCRC = CRC32C::calculate(p, n, blockCRC);
+            blockFill += n;
+            if (blockFill == blockSize || pos + n == size) {
+                blockCRCs.push_back(blockCRC);
+                blockCRC = 0;
+                blockFill = 0;
+            }
+        }
+        emit(p, n);
+        pos += n;
+    }
+}
+
+// 解包方向: 逐块读入 -> 分块 CRC32C (落盘字节) -> 解密 -> CRC32 累加到 crc
+// 分块表在载荷之后，这里只算出实际值，由调用方读表后比对。读不满 size 时返回 false
+template <class Cipher>
+bool openPayload(std::istream& in, Cipher& cipher, char* data, size_t size, uint32_t blockSize,
+                 std::vector<uint32_t>& blockCRCs, uint32_t& crc) {
+    blockCRCs.clear();
+    crc = 0;
+    uint32_t blockCRC = 0;
+    size_t blockFill = 0;
+    for (size_t pos = 0; pos < size;) {
+        size_t n = std::min(PIPELINE_CHUNK, size - pos);
+        if (blockSize != 0) n = std::min<size_t>(n, blockSize - blockFill);
+
+        char* p = data + pos;
+        in.read(p, static_cast<std::streamsize>(n));
+        if (static_cast<size_t>(in.gcount()) != n) return false;
+        if (blockSize != 0) {
+            blockCRC = CRC32C::calculate(p, n, blockCRC);
+            blockFill += n;
+            if (blockFill == blockSize || pos + n == size) {
+                blockCRCs.push_back(blockCRC);
+                blockCRC = 0;
+                blockFill = 0;
+            }
+        }
+        cipher.apply(p, n, pos);
+        crc = CRC32::calculate(p, n, crc);
+        pos += n;
+    }
+    return true;
+}
+
+#endif //MINIBACKUP_PIPELINE_H
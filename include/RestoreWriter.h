@@ -0,0 +1,86 @@
+// include/RestoreWriter.h
+#ifndef MINIBACKUP_RESTOREWRITER_H
+#define MINIBACKUP_RESTOREWRITER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <memory>
+#include <cstdint>
+#include "IoBackend.h"
+
+namespace fs = std::filesystem;
+
+// 解包时每个条目携带的元数据
+struct EntryMeta {
+    uint32_t mode = 0;
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+    int64_t mtime = 0;
+};
+
+// 高吞吐还原写入器
+// - 已创建的目录以 fd 形式缓存，文件用 openat 相对目录 fd 打开，避免每个文件重复解析整条路径
+// - 已知大小的文件先 fallocate 预分配
+// - 元数据通过 fchmod / fchown / futimens 直接作用在已打开的 fd 上
+// - 大文件可选走 O_DIRECT (directIoMinSize > 0 时生效)
+// - 小文件先攒批，交给 IoBackend 一次性 openat/write/close (ioBackend 为 SYNC 时逐个写)
+// 目录的元数据延迟到 finish() 统一回写，避免先写入的权限/时间被后续文件创建覆盖
+class RestoreWriter {
+public:
+    // threads / pool 同 IoBackend::create: pool 为空时线程池后端自建 threads 大小的池
+    explicit RestoreWriter(const fs::path& root, uint64_t directIoMinSize = 0,
+                           IoBackendKind ioBackend = IoBackendKind::AUTO, unsigned threads = 0,
+                           ThreadPool* pool = nullptr);
+    ~RestoreWriter();
+
+    RestoreWriter(const RestoreWriter&) = delete;
+    RestoreWriter& operator=(const RestoreWriter&) = delete;
+
+    void writeFile(const std::string& relPath, const char* data, size_t size, const EntryMeta& meta);
+    void makeDirectory(const std::string& relPath, const EntryMeta& meta);
+    void makeSymlink(const std::string& relPath, const std::string& target, const EntryMeta& meta);
+
+    // 用本次已还原出的 srcRelPath 复制出 relPath (去重引用条目用)
+    void copyFile(const std::string& srcRelPath, const std::string& relPath, const EntryMeta& meta);
+
+    // 写出攒批的小文件，回写目录元数据并释放缓存的目录 fd
+    void finish();
+
+#ifndef _WIN32
+    // 在已打开的 fd 上回写权限/属主/时间 (IoBackend 批量写也用它)
+    static void applyFdMeta(int fd, const EntryMeta& meta);
+#endif
+
+private:
+    fs::path root;
+    uint64_t directIoMinSize;
+
+    struct PendingDir {
+        std::string relPath;
+        EntryMeta meta;
+    };
+    std::vector<PendingDir> pendingDirs;
+
+#ifndef _WIN32
+    int rootFd = -1;
+    std::unordered_map<std::string, int> dirFds; // 相对目录 -> 已打开的目录 fd
+
+    // 小文件攒批: job 里的 dirFd 来自 dirFds，关闭目录 fd 之前必须先 flushWrites
+    std::unique_ptr<IoBackend> io;
+    std::vector<WriteJob> writeBatch;
+    std::vector<std::string> batchPaths;
+    std::vector<std::vector<char>> batchData;
+    std::vector<EntryMeta> batchMeta;
+    size_t batchBytes = 0;
+    void flushWrites();
+
+    int openDir(const std::string& relDir); // 按需逐级创建并缓存
+    void closeDirs();
+    void writeDirect(int fd, const char* data, size_t size);
+    int createFile(const std::string& relPath, size_t size, bool& direct);
+#endif
+};
+
+#endif //MINIBACKUP_RESTOREWRITER_H
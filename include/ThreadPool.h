@@ -0,0 +1,70 @@
+// include/ThreadPool.h
+
+#ifndef MINIBACKUP_THREADPOOL_H
+#define MINIBACKUP_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// 固定大小的线程池，submit 返回 future，任务内的异常会在 get() 时重新抛出
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+
+public:
+    // threads 为 0 时按 CPU 核数
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([this] {
+                for (;;) {
+                    std::packaged_task<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                        if (stopping && tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> fn) {
+        std::packaged_task<void()> task(std::move(fn));
+        std::future<void> result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push(std::move(task));
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+};
+
+#endif //MINIBACKUP_THREADPOOL_H
@@ -0,0 +1,88 @@
+// include/VolumeSet.h
+#ifndef MINIBACKUP_VOLUMESET_H
+#define MINIBACKUP_VOLUMESET_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "PipeStream.h"
+
+// 分卷包
+// 整个包的字节流按固定大小切成 <name>.001、<name>.002 ...，各卷按卷号拼起来就是单文件包，
+// 条目可以跨卷。分卷本身只是原始切片，只有拼起来的整条流是流式格式 (末尾带结束标记)，
+// 缺了末尾的卷会报截断。
+// 分卷可以轮流放到多个目录 (不同磁盘)，每个目录一个 I/O 线程，解包时各目录同时预读。
+// 打包时要把当前卷全部交进写线程的队列才能开始下一卷，所以相邻两卷同时落盘的程度取决于
+// 队列深度: 队列装得下一整卷时前一卷还在写、下一卷已经开写；只有几 MiB 时基本是串行的
+
+// 写线程队列默认最多积压一整卷，但不超过这么多字节 (内存占用 = 目录数 x 队列大小)
+constexpr uint64_t VOLUME_QUEUE_MAX_BYTES = 64ull << 20;
+
+// 卷号从 1 开始，至少 3 位: archive.pck.001
+std::string volumeFileName(const std::string& baseName, unsigned index);
+
+// 打包: 作为 ostream 的缓冲区，按卷切分后交给各目录的写线程
+class VolumeOutBuf : public std::streambuf {
+public:
+    // archivePath: 不带卷号的包路径；dirs 为空时分卷都放在 archivePath 所在目录，
+    // 否则第 k 卷放到 dirs[(k - 1) % dirs.size()]。
+    // queueBytes: 每个写线程最多积压的字节数，0 表示 min(volumeSize, VOLUME_QUEUE_MAX_BYTES)
+    VolumeOutBuf(const std::string& archivePath, uint64_t volumeSize, const std::vector<std::string>& dirs,
+                 size_t chunkSize = PIPE_CHUNK_SIZE, uint64_t queueBytes = 0);
+    ~VolumeOutBuf() override; // 没有 close() (打包出错) 时只等写线程退出，不抛异常
+
+    VolumeOutBuf(const VolumeOutBuf&) = delete;
+    VolumeOutBuf& operator=(const VolumeOutBuf&) = delete;
+
+    // 写出剩余数据并等待所有写线程结束，删除上次打包遗留的多余分卷；任一卷写失败时抛异常
+    void close();
+    unsigned volumeCount() const { return lastVolume; }
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    struct Writer;
+    std::vector<std::unique_ptr<Writer>> writers;
+    std::string baseName;
+    uint64_t volumeSize;
+    size_t chunkSize;
+    std::vector<char> buffer;
+    unsigned volume = 1;          // 当前卷号
+    uint64_t volumeBytes = 0;     // 当前卷已交出的字节数
+    unsigned lastVolume = 0;      // 已有数据的最大卷号
+    bool closed = false;
+
+    void resetPutArea();
+    void pushChunk();
+};
+
+// 解包: 按卷号顺序交出完整字节流。各目录的预读线程把自己的卷按块读进有界队列
+class VolumeInBuf : public std::streambuf {
+public:
+    // 在 archivePath 所在目录和 dirs 里按卷号依次查找，直到某一卷都找不到为止。
+    // archivePath 可以带或不带 ".001"；不是分卷包时返回空
+    static std::vector<std::string> locate(const std::string& archivePath, const std::vector<std::string>& dirs);
+
+    // volumes 为 locate 的结果。读失败时 underflow 抛异常 (istream 需要打开 badbit 异常才能拿到原因)
+    explicit VolumeInBuf(const std::vector<std::string>& volumes, size_t chunkSize = PIPE_CHUNK_SIZE);
+    ~VolumeInBuf() override;
+
+    VolumeInBuf(const VolumeInBuf&) = delete;
+    VolumeInBuf& operator=(const VolumeInBuf&) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct Reader;
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::vector<size_t> readerOf; // 卷下标 -> 负责它的预读线程
+    size_t current = 0;           // 正在读的卷下标
+    std::vector<char> chunk;
+};
+
+#endif //MINIBACKUP_VOLUMESET_H
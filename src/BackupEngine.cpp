@@ -1,10 +1,24 @@
 // src/BackupEngine.cpp
 #include "BackupEngine.h"
 #include "CRC32.h"
+#include "Hash128.h"
+#include "PipeStream.h"
+#include "RestoreWriter.h"
+#include "ThreadPool.h"
+#include "Delta.h"
+#include "Pipeline.h"
+#include "VolumeSet.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <numeric>
+#include <unordered_map>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include <memory>
 #include <chrono> // [新增] 用于时间转换
 
 // [修改] 移除了 sys/stat.h 等底层头文件，改用 C++ 标准库
@@ -18,6 +32,29 @@
     #include <sys/types.h>
 #endif
 
+// 文件头 compFlag 字节: 低位为压缩算法，高位为格式特性位
+constexpr char PCK_COMP_MASK     = 0x07;
+constexpr char PCK_FLAG_DELTA    = 0x08; // 含差量条目，解包需要基准包
+constexpr char PCK_FLAG_BLOCKCRC = 0x10; // 每个条目头后附头校验、数据后附分块 CRC32C 表，包头多 4 字节块大小
+constexpr char PCK_FLAG_DEDUP    = 0x20; // 含去重引用条目
+constexpr char PCK_FLAG_STREAM = 0x40; // 流式格式：末尾带结束标记，可检测截断
+constexpr char PCK_FLAG_ENTRYCODEC = static_cast<char>(0x80); // 每个条目头末尾多 1 字节 codec ID，覆盖低位的整包压缩算法
+
+// 条目类型码 (1=文件, 2=目录, 3=链接)
+constexpr uint8_t PCK_TYPE_END = 0; // 流式格式的结束标记
+constexpr uint8_t PCK_TYPE_REF = 4; // 去重引用: 数据为首份内容所在条目的包内偏移 (uint64)
+constexpr uint8_t PCK_TYPE_DELTA = 5; // 差量: 数据为 basePathLen(8) + basePath + 还原结果的 CRC32(4) + 差量指令流 (见 Delta.h)
+
+// 打包时批量读源文件的窗口: 最多这么多条记录 / 这么多字节 (单个大文件独占一个窗口)
+constexpr size_t READ_BATCH_FILES = 1024;
+constexpr uint64_t READ_BATCH_BYTES = 64ull << 20;
+
+// 包头长度: magic(8) + compFlag(1) [+ blockSize(4)]
+constexpr uint64_t PCK_HEADER_SIZE = 9;
+
+// 条目头固定部分: type(1) + pathLen(8) + size(8) + crc(4) + mode/uid/gid/mtime(20)
+constexpr uint64_t PCK_ENTRY_FIXED_SIZE = 41;
+
 // ==========================================
 // 🛠️ 辅助工具
 // ==========================================
@@ -59,36 +96,117 @@ void fillMetadata(const fs::path& fullPath, FileRecord& record) {
 // ==========================================
 // 核心算法
 // ==========================================
-class RC4 {
-    unsigned char S[256]{};
-    int i = 0, j = 0;
-public:
-    void init(const std::string& key) {
-        if (key.empty()) return;
-        for (int k = 0; k < 256; ++k) S[k] = k;
-        int j_temp = 0;
-        for (int i_temp = 0; i_temp < 256; ++i_temp) {
-            j_temp = (j_temp + S[i_temp] + key[i_temp % key.length()]) % 256;
-            std::swap(S[i_temp], S[j_temp]);
+// 包头
+struct PackHeader {
+    EncryptionMode encMode = EncryptionMode::NONE;
+    char compFlag = 0;
+    uint32_t blockSize = 0; // 0 表示没有分块校验
+    uint64_t size = PCK_HEADER_SIZE;
+
+    uint8_t codec() const { return static_cast<uint8_t>(compFlag & PCK_COMP_MASK); }
+    bool hasEntryCodec() const { return (compFlag & PCK_FLAG_ENTRYCODEC) != 0; }
+    bool isStream() const { return (compFlag & PCK_FLAG_STREAM) != 0; }
+    bool hasDedup() const { return (compFlag & PCK_FLAG_DEDUP) != 0; }
+    bool hasDelta() const { return (compFlag & PCK_FLAG_DELTA) != 0; }
+    bool hasBlockCRC() const { return blockSize != 0; }
+};
+
+PackHeader readPackHeader(std::istream& in) {
+    PackHeader header;
+    char magic[9] = {0};
+    in.read(magic, 8);
+    std::string magicStr(magic);
+
+    if (!cipherFromMagic(magicStr, header.encMode)) throw std::runtime_error("Unknown file format");
+
+    in.read(&header.compFlag, 1);
+    if (header.compFlag & PCK_FLAG_BLOCKCRC) {
+        in.read(reinterpret_cast<char*>(&header.blockSize), 4);
+        if (!in || header.blockSize == 0 || header.blockSize % 4096 != 0) {
+            throw std::runtime_error("Corrupted pack header: bad checksum block size");
         }
-        i = 0; j = 0;
+        header.size += 4;
     }
-    void cipher(char* buffer, const size_t size) {
-        for (size_t k = 0; k < size; ++k) {
-            i = (i + 1) % 256;
-            j = (j + S[i]) % 256;
-            std::swap(S[i], S[j]);
-            buffer[k] ^= S[(S[i] + S[j]) % 256];
-        }
+    return header;
+}
+
+// 条目头
+struct EntryHeader {
+    uint8_t typeCode = 0;
+    std::string relPath;
+    uint64_t dataSize = 0;
+    uint32_t crc = 0;
+    EntryMeta meta;
+    uint8_t codec = PCK_CODEC_STORE;
+    bool codecByte = false; // 头里是否带 codec 字节
+    bool headerCRC = false; // 头后是否带 4 字节头校验
+
+    uint64_t headerSize() const {
+        return PCK_ENTRY_FIXED_SIZE + relPath.size() + (codecByte ? 1 : 0) + (headerCRC ? 4 : 0);
     }
 };
 
-void xorEncrypt(char* buffer, const size_t size, const std::string& password) {
-    if (password.empty()) return;
-    const size_t pwdLen = password.length();
-    for (size_t k = 0; k < size; ++k) {
-        buffer[k] ^= password[k % pwdLen];
+enum class EntryRead {
+    OK,
+    END_MARK, // 流式格式的结束标记
+    END_OF_FILE
+};
+
+// 读取并解密一个条目头。分块校验格式下顺带核对头校验 (落盘字节的 CRC32C)，
+// 不符时抛异常: 长度字段不可信，后面的条目也就无法定位
+template <class Cipher>
+EntryRead readEntryHeader(std::istream& in, Cipher& cipher, const PackHeader& header, EntryHeader& h) {
+    if (in.peek() == EOF) return EntryRead::END_OF_FILE;
+
+    char typeBuf[1];
+    in.read(typeBuf, 1);
+    uint32_t storedCRC = CRC32C::calculate(typeBuf, 1);
+    cipher.apply(typeBuf, 1, 0);
+    h.typeCode = static_cast<uint8_t>(typeBuf[0]);
+    if (header.isStream() && h.typeCode == PCK_TYPE_END) return EntryRead::END_MARK;
+
+    char lenBuf[8];
+    in.read(lenBuf, 8);
+    storedCRC = CRC32C::calculate(lenBuf, 8, storedCRC);
+    cipher.apply(lenBuf, 8, 1);
+    uint64_t pathLen = 0;
+    std::memcpy(&pathLen, lenBuf, 8);
+    if (!in || pathLen > 65536) throw std::runtime_error("Corrupted entry header");
+
+    h.relPath.resize(pathLen);
+    in.read(h.relPath.data(), static_cast<std::streamsize>(pathLen));
+    storedCRC = CRC32C::calculate(h.relPath.data(), pathLen, storedCRC);
+    cipher.apply(h.relPath.data(), pathLen, 9);
+
+    h.codecByte = header.hasEntryCodec();
+    h.headerCRC = header.hasBlockCRC();
+    const size_t restSize = h.codecByte ? 33 : 32;
+    char rest[33];
+    in.read(rest, static_cast<std::streamsize>(restSize));
+    if (!in) throw std::runtime_error("Truncated entry header: " + h.relPath);
+    storedCRC = CRC32C::calculate(rest, restSize, storedCRC);
+    cipher.apply(rest, restSize, 9 + pathLen);
+
+    if (h.headerCRC) {
+        uint32_t expected = 0;
+        in.read(reinterpret_cast<char*>(&expected), 4);
+        if (!in) throw std::runtime_error("Truncated entry header: " + h.relPath);
+        if (expected != storedCRC) throw std::runtime_error("Entry header checksum mismatch: " + h.relPath);
     }
+
+    std::memcpy(&h.dataSize, rest, 8);
+    std::memcpy(&h.crc, rest + 8, 4);
+    std::memcpy(&h.meta.mode, rest + 12, 4);
+    std::memcpy(&h.meta.uid, rest + 16, 4);
+    std::memcpy(&h.meta.gid, rest + 20, 4);
+    std::memcpy(&h.meta.mtime, rest + 24, 8);
+    h.codec = h.codecByte ? static_cast<uint8_t>(rest[32]) : header.codec();
+    if (!findCodec(h.codec)) throw std::runtime_error("Unknown codec in entry: " + h.relPath);
+    return EntryRead::OK;
+}
+
+uint64_t blockCount(uint64_t dataSize, uint32_t blockSize) {
+    return (dataSize + blockSize - 1) / blockSize;
 }
 
 // 筛选器逻辑
@@ -128,27 +246,62 @@ bool checkFilter(const FileRecord& record, const FilterOptions& opts) {
     return true;
 }
 
-// RLE
-void rleCompress(const std::vector<char>& input, std::vector<char>& output) {
-    if (input.empty()) return;
-    for (size_t i = 0; i < input.size(); ++i) {
-        unsigned char count = 1;
-        while (i + 1 < input.size() && input[i] == input[i+1] && count < 255) {
-            count++; i++;
-        }
-        output.push_back(static_cast<char>(count));
-        output.push_back(input[i]);
+// ==========================================
+// 条目编码选择 (CompressionMode::AUTO)
+// ==========================================
+
+// 本身已压缩/加密的格式，不必采样直接存储
+bool hasIncompressibleExt(const std::string& relPath) {
+    static const char* const kExts[] = {
+        ".jpg", ".jpeg", ".png", ".gif", ".webp", ".heic",
+        ".mp3", ".aac", ".ogg", ".flac", ".mp4", ".mkv", ".mov", ".avi", ".webm",
+        ".zip", ".gz", ".tgz", ".bz2", ".xz", ".zst", ".7z", ".rar", ".lz4",
+        ".jar", ".apk", ".docx", ".xlsx", ".pptx", ".pdf", ".gpg", ".pck"
+    };
+    const size_t dot = relPath.find_last_of('.');
+    if (dot == std::string::npos || relPath.size() - dot > 6) return false;
+    std::string ext = relPath.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const char* e : kExts) {
+        if (ext == e) return true;
     }
+    return false;
 }
 
-void rleDecompress(const std::vector<char>& input, std::vector<char>& output) {
-    if (input.empty()) return;
-    for (size_t i = 0; i < input.size(); i += 2) {
-        if (i + 1 >= input.size()) break;
-        const auto count = static_cast<unsigned char>(input[i]);
-        char value = input[i+1];
-        for (int k = 0; k < count; ++k) output.push_back(value);
+// 为一个条目挑选 codec: AUTO 时让每个提供了 estimate 的已注册 codec 估计压缩比，取最小的
+uint8_t chooseCodec(const std::string& relPath, const std::vector<char>& data, CompressionMode mode) {
+    if (mode == CompressionMode::NONE || data.empty()) return PCK_CODEC_STORE;
+    if (mode == CompressionMode::RLE) return PCK_CODEC_RLE;
+
+    if (hasIncompressibleExt(relPath)) return PCK_CODEC_STORE;
+    const CodecSample sample = sampleData(data.data(), data.size());
+    if (sample.entropy > 7.5) return PCK_CODEC_STORE;
+
+    // 预计至少省 10% 才值得花解码的 CPU
+    uint8_t best = PCK_CODEC_STORE;
+    double bestRatio = 0.9;
+    for (const Codec* codec : registeredCodecs()) {
+        if (!codec->estimate) continue;
+        const double ratio = codec->estimate(sample, data.data(), data.size());
+        if (ratio < bestRatio) {
+            best = codec->id;
+            bestRatio = ratio;
+        }
     }
+    return best;
+}
+
+// ==========================================
+// 引擎实例
+// ==========================================
+BackupEngine::BackupEngine(EngineConfig config) : config(std::move(config)) {}
+
+EngineLogger BackupEngine::logger(bool stdoutBusy) const {
+    if (config.logger) return config.logger;
+    return [stdoutBusy](LogLevel level, const std::string& message) {
+        std::ostream& out = (level == LogLevel::ERROR || stdoutBusy) ? std::cerr : std::cout;
+        out << message << std::endl;
+    };
 }
 
 // ==========================================
@@ -156,7 +309,7 @@ void rleDecompress(const std::vector<char>& input, std::vector<char>& output) {
 // ==========================================
 
 // 1. 基础备份 (支持单文件)
-void BackupEngine::backup(const std::string& srcPath, const std::string& destPath) {
+void BackupEngine::backup(const std::string& srcPath, const std::string& destPath) const {
     fs::path source = fs::u8path(srcPath);
     fs::path destination = fs::u8path(destPath);
 
@@ -166,7 +319,8 @@ void BackupEngine::backup(const std::string& srcPath, const std::string& destPat
     std::ofstream indexFile(destination / "index.txt");
     if (!indexFile.is_open()) throw std::runtime_error("Cannot create index file");
 
-    std::cout << "Scanning and backing up..." << std::endl;
+    const EngineLogger log = logger();
+    log(LogLevel::INFO, "Scanning and backing up...");
     int successCount = 0;
 
     auto processOneFile = [&](const fs::path& filePath, const fs::path& relPath) {
@@ -178,7 +332,7 @@ void BackupEngine::backup(const std::string& srcPath, const std::string& destPat
         std::string checksum = CRC32::getFileCRC(filePath);
         indexFile << pathToString(relPath) << "|" << checksum << "\n";
 
-        std::cout << "  [OK] " << relPath.string() << std::endl;
+        log(LogLevel::INFO, "  [OK] " + relPath.string());
         successCount++;
     };
 
@@ -197,11 +351,11 @@ void BackupEngine::backup(const std::string& srcPath, const std::string& destPat
         }
     }
     indexFile.close();
-    std::cout << "[Backup] Complete. Success: " << successCount << std::endl;
+    log(LogLevel::INFO, "[Backup] Complete. Success: " + std::to_string(successCount));
 }
 
 // 2. 基础校验 (返回 string 错误信息)
-std::string BackupEngine::verify(const std::string& destPath) {
+std::string BackupEngine::verify(const std::string& destPath) const {
     fs::path destination = fs::u8path(destPath);
     fs::path indexFilePath = destination / "index.txt";
 
@@ -237,12 +391,18 @@ std::string BackupEngine::verify(const std::string& destPath) {
     return (errorCount > 0) ? errorMsg.str() : "";
 }
 
-// 3. 基础恢复
-void BackupEngine::restore(const std::string& srcPath, const std::string& destPath) {
+// 3. 基础恢复 (differential 时只改写有差异的文件)
+void BackupEngine::restore(const std::string& srcPath, const std::string& destPath,
+                           const RestoreOptions& opts) const {
     const fs::path backupDir = fs::u8path(srcPath);
     const fs::path targetDir = fs::u8path(destPath);
     if (!fs::exists(targetDir)) fs::create_directories(targetDir);
 
+    if (opts.differential) {
+        restoreDifferential(backupDir, targetDir, opts);
+        return;
+    }
+
     for (const auto& entry : fs::recursive_directory_iterator(backupDir)) {
         try {
             fs::path relativePath = fs::relative(entry.path(), backupDir);
@@ -258,36 +418,343 @@ void BackupEngine::restore(const std::string& srcPath, const std::string& destPa
     }
 }
 
+// 3.1 差异恢复
+// 镜像里的文件先按大小比较，大小相同再比 mtime，mtime 不同才算 CRC (镜像一侧优先用 index.txt 里的值)。
+// 相同的文件只把 mtime 对齐到镜像，下次比较直接命中 mtime
+void BackupEngine::restoreDifferential(const fs::path& backupDir, const fs::path& targetDir,
+                                       const RestoreOptions& opts) const {
+    const EngineLogger log = logger();
+    if (!fs::is_directory(backupDir)) throw std::runtime_error("Backup directory not found");
+
+    std::unordered_map<std::string, std::string> indexCRC;
+    {
+        std::ifstream indexFile(backupDir / "index.txt");
+        std::string line;
+        while (std::getline(indexFile, line)) {
+            size_t delimiterPos = line.find('|');
+            if (delimiterPos != std::string::npos) indexCRC[line.substr(0, delimiterPos)] = line.substr(delimiterPos + 1);
+        }
+    }
+
+    // 相对路径按迭代深度拼出来 (同 scanDirectory)。不能用 fs::relative: 它会解析符号链接，
+    // 目标里指向保留文件的多余链接就会被当成那个文件而躲过删除
+    auto relPathOf = [](const fs::recursive_directory_iterator& it, std::vector<std::string>& dirRelPaths) {
+        const size_t depth = static_cast<size_t>(it.depth());
+        std::string rel;
+        if (depth > 0) {
+            rel = dirRelPaths[depth - 1];
+            rel.push_back(static_cast<char>(fs::path::preferred_separator));
+        }
+        rel += pathToString(it->path().filename());
+        if (dirRelPaths.size() <= depth) dirRelPaths.resize(depth + 1);
+        dirRelPaths[depth] = rel;
+        return rel;
+    };
+
+    // 1. 顺序遍历镜像: 目录直接建好，文件收集起来并行比较
+    std::vector<std::string> files;
+    std::unordered_set<std::string> keep;
+    std::error_code ec;
+    std::vector<std::string> dirRelPaths;
+    for (auto it = fs::recursive_directory_iterator(backupDir, ec); !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec)) {
+        const std::string rel = relPathOf(it, dirRelPaths);
+        if (it.depth() == 0 && rel == "index.txt") continue;
+        keep.insert(rel);
+        if (it->is_directory()) {
+            fs::path dir = targetDir / fs::u8path(rel);
+            std::error_code dirEc;
+            // 目标上同名的是文件或符号链接 (is_directory 会顺着链接判断，指向目录的链接也要删)
+            if (fs::is_symlink(dir, dirEc) || !fs::is_directory(dir, dirEc)) {
+                fs::remove(dir, dirEc);
+                fs::create_directories(dir);
+            }
+        } else {
+            files.push_back(rel);
+        }
+    }
+    if (ec) throw std::runtime_error("Cannot scan backup directory: " + ec.message());
+
+    // 2. 并行比较并覆盖有差异的文件
+    // 兜底: 写入位置的上级目录解析后必须仍在目标目录里，不能经由符号链接写到外面
+    const fs::path targetReal = fs::weakly_canonical(targetDir);
+    auto insideTarget = [&targetReal](const fs::path& dir) {
+        std::error_code relEc;
+        const fs::path rel = fs::weakly_canonical(dir, relEc).lexically_relative(targetReal);
+        return !relEc && !rel.empty() && *rel.begin() != "..";
+    };
+
+    std::atomic<int> copied{0}, unchanged{0}, failed{0};
+    auto syncOne = [&](const std::string& rel) {
+        const fs::path src = backupDir / fs::u8path(rel);
+        const fs::path dst = targetDir / fs::u8path(rel);
+        try {
+            if (!insideTarget(dst.parent_path())) {
+                throw std::runtime_error("destination resolves outside the target directory");
+            }
+            const uint64_t srcSize = fs::file_size(src);
+            const auto srcTime = fs::last_write_time(src);
+
+            std::error_code stEc;
+            bool same = false;
+            // 目标上同名的是符号链接时先删掉，免得顺着链接比较/写到目标目录之外
+            if (fs::is_symlink(dst, stEc)) fs::remove(dst);
+            if (fs::is_regular_file(dst, stEc) && fs::file_size(dst, stEc) == srcSize && !stEc) {
+                if (fs::last_write_time(dst, stEc) == srcTime) {
+                    same = true;
+                } else {
+                    auto hit = indexCRC.find(rel);
+                    const std::string expected = (hit != indexCRC.end()) ? hit->second : CRC32::getFileCRC(src);
+                    same = (CRC32::getFileCRC(dst) == expected);
+                }
+            } else if (fs::is_directory(dst, stEc)) {
+                fs::remove_all(dst);
+            }
+
+            if (same) {
+                unchanged++;
+            } else {
+                fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+                copied++;
+            }
+            fs::last_write_time(dst, srcTime);
+        } catch (const std::exception& e) {
+            failed++;
+            log(LogLevel::ERROR, "[Error] Restore failed: " + rel + " (" + e.what() + ")");
+        }
+    };
+
+    constexpr size_t FILES_PER_TASK = 256;
+    {
+        std::unique_ptr<ThreadPool> ownPool;
+        ThreadPool* pool = config.pool;
+        if (!pool) {
+            ownPool = std::make_unique<ThreadPool>(opts.threads ? opts.threads : config.threads);
+            pool = ownPool.get();
+        }
+        std::vector<std::future<void>> futures;
+        for (size_t first = 0; first < files.size(); first += FILES_PER_TASK) {
+            const size_t last = std::min(files.size(), first + FILES_PER_TASK);
+            futures.push_back(pool->submit([&, first, last] {
+                for (size_t k = first; k < last; ++k) syncOne(files[k]);
+            }));
+        }
+        for (auto& f : futures) f.get();
+    }
+
+    // 3. 删除镜像里没有的条目 (多余的目录整棵删掉，不再深入)
+    int deleted = 0;
+    if (opts.deleteExtra) {
+        std::vector<fs::path> extra;
+        dirRelPaths.clear();
+        for (auto it = fs::recursive_directory_iterator(targetDir, ec); !ec && it != fs::recursive_directory_iterator();
+             it.increment(ec)) {
+            if (keep.count(relPathOf(it, dirRelPaths))) continue;
+            extra.push_back(it->path());
+            if (it->is_directory() && !it->is_symlink()) it.disable_recursion_pending();
+        }
+        for (const auto& p : extra) {
+            std::error_code rmEc;
+            fs::remove_all(p, rmEc);
+            if (rmEc) {
+                failed++;
+                log(LogLevel::ERROR, "[Error] Cannot delete: " + pathToString(p));
+            } else {
+                deleted++;
+            }
+        }
+    }
+
+    log(LogLevel::INFO, "[Restore] Copied: " + std::to_string(copied.load()) + ", Unchanged: "
+                        + std::to_string(unchanged.load()) + ", Deleted: " + std::to_string(deleted)
+                        + ", Failed: " + std::to_string(failed.load()));
+    if (failed > 0) throw std::runtime_error("Differential restore finished with errors");
+}
+
+// 2.1 包校验: 不解包、不落盘，按分块 CRC 多线程核对并给出损坏的字节范围
+std::string BackupEngine::verifyPack(const std::string& packFile, const std::string& password,
+                                     unsigned threads) const {
+    const fs::path packPath = fs::u8path(packFile);
+    std::ifstream in(packPath, std::ios::binary);
+    if (!in.is_open()) return "错误：无法打开包文件";
+
+    std::error_code ec;
+    const uint64_t fileSize = fs::file_size(packPath, ec);
+
+    PackHeader header;
+    try {
+        header = readPackHeader(in);
+    } catch (const std::exception& e) {
+        return std::string("错误：") + e.what();
+    }
+
+    std::stringstream errorMsg;
+    int errorCount = 0;
+
+    // 第一遍顺序走条目头，收集所有待核对的块
+    struct BlockJob {
+        size_t entry;         // entryPaths 下标
+        uint64_t index;       // 条目内块号
+        uint64_t dataStart;   // 条目数据内的起始偏移
+        uint64_t archiveStart;
+        uint64_t len;
+        uint32_t crc;
+    };
+    std::vector<std::string> entryPaths;
+    std::vector<BlockJob> jobs;
+
+    EntryHeader entry;
+    uint64_t offset = header.size;
+    withCipher(header.encMode, password, [&](auto& cipher) {
+        while (true) {
+            EntryRead status;
+            try {
+                status = readEntryHeader(in, cipher, header, entry);
+            } catch (const std::exception& e) {
+                errorMsg << "❌ 条目头损坏: 包内偏移 " << offset << " (" << e.what() << ")\n";
+                errorCount++;
+                break;
+            }
+            if (status != EntryRead::OK) {
+                if (header.isStream() && status != EntryRead::END_MARK) {
+                    errorMsg << "❌ 截断: 缺少流式结束标记\n";
+                    errorCount++;
+                }
+                break;
+            }
+
+            const uint64_t payloadStart = offset + entry.headerSize();
+            if (fileSize != 0 && payloadStart + entry.dataSize > fileSize) {
+                errorMsg << "❌ 截断: " << entry.relPath << " 数据超出包尾\n";
+                errorCount++;
+                break;
+            }
+
+            uint64_t tableSize = 0;
+            if (entry.dataSize > 0 && header.hasBlockCRC()) {
+                cipher.skip(entry.dataSize);
+                in.seekg(static_cast<std::streamoff>(entry.dataSize), std::ios::cur);
+
+                std::vector<uint32_t> table(blockCount(entry.dataSize, header.blockSize));
+                tableSize = table.size() * 4;
+                in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(tableSize));
+                if (!in) {
+                    errorMsg << "❌ 截断: " << entry.relPath << " 缺少分块校验表\n";
+                    errorCount++;
+                    break;
+                }
+
+                entryPaths.push_back(entry.relPath);
+                for (uint64_t b = 0; b < table.size(); ++b) {
+                    uint64_t start = b * header.blockSize;
+                    uint64_t len = std::min<uint64_t>(header.blockSize, entry.dataSize - start);
+                    jobs.push_back({entryPaths.size() - 1, b, start, payloadStart + start, len, table[b]});
+                }
+            } else if (entry.dataSize > 0) {
+                // 旧格式没有分块表，只能顺序解密后核对整条 CRC
+                std::vector<char> data(entry.dataSize);
+                std::vector<uint32_t> unused;
+                uint32_t crc = 0;
+                if (!openPayload(in, cipher, data.data(), data.size(), 0, unused, crc) || crc != entry.crc) {
+                    errorMsg << "❌ 校验失败: " << entry.relPath << " (无分块校验，无法定位)\n";
+                    errorCount++;
+                }
+            }
+            offset = payloadStart + entry.dataSize + tableSize;
+        }
+    });
+
+    // 第二遍并行核对: 每个任务独立打开包文件，按块顺序读取
+    if (!jobs.empty()) {
+        constexpr size_t BLOCKS_PER_TASK = 64;
+        std::vector<const BlockJob*> badBlocks;
+        std::mutex badMtx;
+        {
+            // 有共享池就用共享池，否则临时建一个
+            std::unique_ptr<ThreadPool> ownPool;
+            ThreadPool* pool = config.pool;
+            if (!pool) {
+                ownPool = std::make_unique<ThreadPool>(threads ? threads : config.threads);
+                pool = ownPool.get();
+            }
+            std::vector<std::future<void>> futures;
+            for (size_t first = 0; first < jobs.size(); first += BLOCKS_PER_TASK) {
+                size_t last = std::min(jobs.size(), first + BLOCKS_PER_TASK);
+                futures.push_back(pool->submit([&, first, last] {
+                    std::ifstream f(packPath, std::ios::binary);
+                    std::vector<char> buffer(header.blockSize);
+                    for (size_t k = first; k < last; ++k) {
+                        const BlockJob& job = jobs[k];
+                        f.seekg(static_cast<std::streamoff>(job.archiveStart));
+                        f.read(buffer.data(), static_cast<std::streamsize>(job.len));
+                        if (!f || CRC32C::calculate(buffer.data(), job.len) != job.crc) {
+                            std::lock_guard<std::mutex> lock(badMtx);
+                            badBlocks.push_back(&job);
+                            f.clear();
+                        }
+                    }
+                }));
+            }
+            for (auto& fu : futures) fu.get();
+        }
+
+        std::sort(badBlocks.begin(), badBlocks.end(),
+                  [](const BlockJob* a, const BlockJob* b) { return a->archiveStart < b->archiveStart; });
+        for (const BlockJob* job : badBlocks) {
+            errorMsg << "❌ 损坏: " << entryPaths[job->entry] << " 块 #" << job->index
+                     << " 数据字节 [" << job->dataStart << ", " << job->dataStart + job->len << ")"
+                     << " 包内字节 [" << job->archiveStart << ", " << job->archiveStart + job->len << ")\n";
+            errorCount++;
+        }
+    }
+
+    return (errorCount > 0) ? errorMsg.str() : "";
+}
+
 // ==========================================
 // 4. 高级打包
 // ==========================================
 
-std::vector<FileRecord> BackupEngine::scanDirectory(const std::string& sourcePath, const FilterOptions& filter) {
-    std::vector<FileRecord> files;
+FileList BackupEngine::scanDirectory(const std::string& sourcePath, const FilterOptions& filter) {
     fs::path source = fs::u8path(sourcePath);
 
-    if (!fs::exists(source)) return files;
+    if (!fs::exists(source)) return FileList();
 
-    // 单文件
+    // 单文件: 以所在目录为根，只登记一个节点
     if (fs::is_regular_file(source)) {
+        FileList files(pathToString(source.parent_path()));
         FileRecord record;
-        record.absPath = pathToString(source);
         record.relPath = pathToString(source.filename());
         record.type = FileType::REGULAR;
 
         // 🔥 调用新的元数据获取逻辑
         fillMetadata(source, record);
 
-        if (checkFilter(record, filter)) files.push_back(record);
+        if (checkFilter(record, filter)) files.add(files.addNode(FileList::NO_PARENT, record.relPath), record);
         return files;
     }
 
     // 目录
+    FileList files(pathToString(source));
     if (fs::is_directory(source)) {
-        for (const auto& entry : fs::recursive_directory_iterator(source)) {
-            FileRecord record;
-            record.absPath = pathToString(entry.path());
-            record.relPath = pathToString(fs::relative(entry.path(), source));
+        // 每层目录的节点下标和相对路径，按迭代深度维护，省掉 fs::relative
+        std::vector<uint32_t> dirNodes;
+        std::vector<std::string> dirRelPaths;
+        FileRecord record; // 复用同一个记录，字符串容量不反复分配
+
+        for (auto it = fs::recursive_directory_iterator(source); it != fs::recursive_directory_iterator(); ++it) {
+            const auto& entry = *it;
+            const size_t depth = static_cast<size_t>(it.depth());
+            const uint32_t parent = (depth == 0) ? FileList::NO_PARENT : dirNodes[depth - 1];
+            const std::string name = pathToString(entry.path().filename());
+
+            record.relPath.clear();
+            if (depth > 0) {
+                record.relPath = dirRelPaths[depth - 1];
+                record.relPath.push_back(static_cast<char>(fs::path::preferred_separator));
+            }
+            record.relPath += name;
+            record.linkTarget.clear();
 
             // 🔥 调用新的元数据获取逻辑
             fillMetadata(entry.path(), record);
@@ -303,63 +770,176 @@ std::vector<FileRecord> BackupEngine::scanDirectory(const std::string& sourcePat
                 try { record.linkTarget = pathToString(fs::read_symlink(entry.path())); } catch (...) {}
             } else { continue; }
 
-            if (checkFilter(record, filter)) files.push_back(record);
+            bool keep = checkFilter(record, filter);
+
+            // 目录即使被筛掉，也要登记为子项的父节点
+            if (record.type == FileType::DIRECTORY) {
+                uint32_t node = files.addNode(parent, name);
+                if (dirNodes.size() <= depth) {
+                    dirNodes.resize(depth + 1);
+                    dirRelPaths.resize(depth + 1);
+                }
+                dirNodes[depth] = node;
+                dirRelPaths[depth] = record.relPath;
+                if (keep) files.add(node, record);
+            } else if (keep) {
+                files.add(files.addNode(parent, name), record);
+            }
         }
     }
     return files;
 }
 
-// 打包 Files
-void BackupEngine::packFiles(const std::vector<FileRecord>& files, const std::string& outputFile,
-                             const std::string& password, EncryptionMode encMode, CompressionMode compMode) {
+// ==========================================
+// 打包/解包核心 (不关心数据来自文件还是内存)
+// ==========================================
 
-    std::ofstream out(fs::u8path(outputFile), std::ios::binary);
-    if (!out.is_open()) throw std::runtime_error("Cannot create pack file");
+// 基准包里每个文件的差量签名。去重引用条目直接指向首份内容的路径，
+// 这样差量条目引用的 basePath 在基准包里总是一个普通文件条目
+struct DeltaBaseFile {
+    std::string basePath;
+    std::shared_ptr<const DeltaSignature> sig;
+};
+using DeltaBase = std::unordered_map<std::string, DeltaBaseFile>;
+
+// 打包写出器: 写包头，逐条做去重/差量/压缩/校验/加密，编码后的字节全部交给 sink。
+// 加密策略由 withCipher 按包选定，整包共用同一个策略对象 (RC4 密钥流连续)
+template <class Cipher>
+class PackWriter {
+    const PackSink& sink;
+    const DeltaBase* deltaBase;
+    CompressionMode compMode;
+    PackOptions opts;
+    bool streamMode;
+    Cipher& cipher;
+    std::vector<uint32_t> blockCRCs;
+
+    // 去重: 先登记所有文件大小，只有大小撞车的文件才需要算哈希
+    std::unordered_map<uint64_t, uint32_t> sizeCount;
+    struct FirstCopy { uint64_t size; uint64_t offset; };
+    std::unordered_map<Hash128Value, FirstCopy, Hash128ValueHasher> firstCopies;
+
+    PackStats stats;
+    uint64_t archiveOffset = 0; // stdout / sink 不能 tellp，自己累计
+
+    void emit(const char* data, size_t size) {
+        sink(data, size);
+        archiveOffset += size;
+    }
 
-    if (encMode == EncryptionMode::RC4) out.write("MINIBK_R", 8);
-    else if (encMode == EncryptionMode::XOR) out.write("MINIBK_X", 8);
-    else out.write("MINIBK10", 8);
+public:
+    // magic 按 encMode 写 (与旧版一致: 空密码时 magic 仍标记算法，数据不加密)
+    PackWriter(const PackSink& sink, Cipher& cipher, EncryptionMode encMode,
+               CompressionMode compMode, const PackOptions& opts, bool streamMode,
+               const DeltaBase* deltaBase = nullptr)
+        : sink(sink), deltaBase(deltaBase), compMode(compMode), opts(opts), streamMode(streamMode),
+          cipher(cipher) {
+        if (opts.checksumBlockSize != 0 && opts.checksumBlockSize % 4096 != 0) {
+            throw std::runtime_error("Checksum block size must be a multiple of 4096");
+        }
 
-    char compFlag = (compMode == CompressionMode::RLE) ? 1 : 0;
-    out.write(&compFlag, 1);
+        emit(cipherMagic(encMode), 8);
 
-    RC4 rc4;
-    if (encMode == EncryptionMode::RC4 && !password.empty()) rc4.init(password);
+        // 压缩时 codec 按条目记录，整包的低位算法留 0
+        char compFlag = (compMode == CompressionMode::NONE) ? 0 : PCK_FLAG_ENTRYCODEC;
+        if (streamMode) compFlag |= PCK_FLAG_STREAM;
+        if (opts.dedup) compFlag |= PCK_FLAG_DEDUP;
+        if (opts.checksumBlockSize != 0) compFlag |= PCK_FLAG_BLOCKCRC;
+        if (deltaBase) compFlag |= PCK_FLAG_DELTA;
+        emit(&compFlag, 1);
+        if (opts.checksumBlockSize != 0) emit(reinterpret_cast<const char*>(&opts.checksumBlockSize), 4);
+    }
 
-    int count = 0;
-    for (const auto& rec : files) {
-        if (rec.type == FileType::OTHER) continue;
+    // 写条目前先把每个普通文件的大小登记一遍 (去重预筛)
+    void countSize(uint64_t size) {
+        if (opts.dedup && size > 0) sizeCount[size]++;
+    }
 
-        std::vector<char> fileData;
-        if (rec.type == FileType::REGULAR) {
-            std::ifstream inFile(fs::u8path(rec.absPath), std::ios::binary);
-            if (inFile) {
-                fileData.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+    // fileData 会被就地压缩/加密
+    void addEntry(FileType type, const std::string& relPath, const EntryMeta& meta, std::vector<char>& fileData) {
+        if (type == FileType::OTHER) return;
+
+        const uint64_t entryOffset = archiveOffset;
+        uint8_t typeCode = (type == FileType::REGULAR ? 1 : (type == FileType::DIRECTORY ? 2 : 3));
+
+        // 去重: 内容与之前某个文件相同，则只记录那个条目的偏移
+        bool dedupCandidate = false;
+        Hash128Value contentHash;
+        if (opts.dedup && typeCode == 1 && !fileData.empty()) {
+            auto sc = sizeCount.find(fileData.size());
+            if (sc != sizeCount.end() && sc->second > 1) {
+                contentHash = Hash128::calculate(fileData.data(), fileData.size());
+                auto hit = firstCopies.find(contentHash);
+                if (hit == firstCopies.end()) {
+                    dedupCandidate = true;
+                } else if (hit->second.size == fileData.size()) {
+                    stats.dedupRefs++;
+                    stats.dedupBytes += fileData.size();
+                    typeCode = PCK_TYPE_REF;
+                    uint64_t refOffset = hit->second.offset;
+                    auto pRef = reinterpret_cast<const char*>(&refOffset);
+                    fileData.assign(pRef, pRef + 8);
+                }
             }
-        } else if (rec.type == FileType::SYMLINK) {
-            std::string target = rec.linkTarget;
-            fileData.assign(target.begin(), target.end());
         }
 
-        if (compMode == CompressionMode::RLE && !fileData.empty()) {
+        // 差量: 基准包里有同路径文件，只存相对它的差量指令
+        if (deltaBase && typeCode == 1) {
+            auto base = deltaBase->find(relPath);
+            if (base != deltaBase->end()) {
+                std::vector<char> ops;
+                if (computeDelta(*base->second.sig, fileData.data(), fileData.size(), ops)) {
+                    stats.deltaEntries++;
+                    stats.deltaBytes += fileData.size() - ops.size();
+
+                    // 记下还原结果的 CRC，解包时拿错了基准包 (同路径不同内容) 也能发现
+                    const uint32_t targetCRC = CRC32::calculate(fileData.data(), fileData.size());
+                    std::vector<char> payload;
+                    uint64_t basePathLen = base->second.basePath.size();
+                    auto pLen = reinterpret_cast<const char*>(&basePathLen);
+                    payload.insert(payload.end(), pLen, pLen + 8);
+                    payload.insert(payload.end(), base->second.basePath.begin(), base->second.basePath.end());
+                    auto pCRC = reinterpret_cast<const char*>(&targetCRC);
+                    payload.insert(payload.end(), pCRC, pCRC + 4);
+                    payload.insert(payload.end(), ops.begin(), ops.end());
+                    fileData.swap(payload);
+                    typeCode = PCK_TYPE_DELTA;
+                }
+            }
+        }
+
+        // 只有最终存成普通文件条目的内容才能作为后续去重引用的目标
+        if (dedupCandidate && typeCode == 1) {
+            firstCopies.emplace(contentHash, FirstCopy{fileData.size(), entryOffset});
+        }
+
+        uint8_t codec = (typeCode == PCK_TYPE_REF) ? PCK_CODEC_STORE : chooseCodec(relPath, fileData, compMode);
+        const Codec* encoder = findCodec(codec);
+        if (encoder->encode) {
             std::vector<char> compressed;
-            rleCompress(fileData, compressed);
-            fileData = compressed;
+            encoder->encode(fileData.data(), fileData.size(), compressed);
+            // 压缩后反而变大则退回原样存储
+            if (compressed.size() < fileData.size()) {
+                fileData.swap(compressed);
+                stats.compressedEntries++;
+            } else {
+                codec = PCK_CODEC_STORE;
+            }
         }
 
+        // 条目头 (含 CRC) 在数据之前加密，RC4 密钥流要求先定下头部，所以 CRC 只能单独先算一遍
         uint32_t fileCRC = 0;
         if (!fileData.empty()) {
             fileCRC = CRC32::calculate(fileData.data(), fileData.size());
         }
 
         std::vector<char> metaBuffer;
-        uint8_t typeCode = (rec.type == FileType::REGULAR ? 1 : (rec.type == FileType::DIRECTORY ? 2 : 3));
         metaBuffer.push_back(static_cast<char>(typeCode));
 
-        uint64_t pathLen = rec.relPath.size();
+        uint64_t pathLen = relPath.size();
         auto pLen = reinterpret_cast<const char*>(&pathLen);
         metaBuffer.insert(metaBuffer.end(), pLen, pLen + 8);
-        metaBuffer.insert(metaBuffer.end(), rec.relPath.begin(), rec.relPath.end());
+        metaBuffer.insert(metaBuffer.end(), relPath.begin(), relPath.end());
 
         uint64_t finalSize = fileData.size();
         auto pSize = reinterpret_cast<const char*>(&finalSize);
@@ -368,144 +948,562 @@ void BackupEngine::packFiles(const std::vector<FileRecord>& files, const std::st
         auto pCRC = reinterpret_cast<const char*>(&fileCRC);
         metaBuffer.insert(metaBuffer.end(), pCRC, pCRC + 4);
 
-        auto pMode = reinterpret_cast<const char*>(&rec.mode);
+        auto pMode = reinterpret_cast<const char*>(&meta.mode);
         metaBuffer.insert(metaBuffer.end(), pMode, pMode + 4);
-        auto pUid = reinterpret_cast<const char*>(&rec.uid);
+        auto pUid = reinterpret_cast<const char*>(&meta.uid);
         metaBuffer.insert(metaBuffer.end(), pUid, pUid + 4);
-        auto pGid = reinterpret_cast<const char*>(&rec.gid);
+        auto pGid = reinterpret_cast<const char*>(&meta.gid);
         metaBuffer.insert(metaBuffer.end(), pGid, pGid + 4);
-        auto pTime = reinterpret_cast<const char*>(&rec.mtime);
+        auto pTime = reinterpret_cast<const char*>(&meta.mtime);
         metaBuffer.insert(metaBuffer.end(), pTime, pTime + 8);
+        if (compMode != CompressionMode::NONE) metaBuffer.push_back(static_cast<char>(codec));
 
-        if (encMode == EncryptionMode::RC4 && !password.empty()) rc4.cipher(metaBuffer.data(), metaBuffer.size());
-        else if (encMode == EncryptionMode::XOR && !password.empty()) xorEncrypt(metaBuffer.data(), metaBuffer.size(), password);
-        out.write(metaBuffer.data(), metaBuffer.size());
+        cipher.apply(metaBuffer.data(), metaBuffer.size());
+        emit(metaBuffer.data(), metaBuffer.size());
+
+        // 头校验: 分块表只覆盖数据，条目头 (长度/CRC/元数据) 单独记一个 CRC32C，紧跟在头后面，
+        // 解包时先核对头再按其中的长度读数据
+        if (opts.checksumBlockSize != 0) {
+            const uint32_t headerCRC = CRC32C::calculate(metaBuffer.data(), metaBuffer.size());
+            emit(reinterpret_cast<const char*>(&headerCRC), 4);
+        }
 
         if (!fileData.empty()) {
-            if (encMode == EncryptionMode::RC4 && !password.empty()) rc4.cipher(fileData.data(), fileData.size());
-            else if (encMode == EncryptionMode::XOR && !password.empty()) xorEncrypt(fileData.data(), fileData.size(), password);
-            out.write(fileData.data(), fileData.size());
+            // 加密、分块 CRC、写出在同一遍里逐块完成。
+            // 分块 CRC 针对落盘的字节 (加密后)，校验时不需要密码也不需要解码
+            sealPayload(cipher, fileData.data(), fileData.size(), opts.checksumBlockSize, blockCRCs,
+                        [this](const char* data, size_t size) { emit(data, size); });
+            if (!blockCRCs.empty()) {
+                emit(reinterpret_cast<const char*>(blockCRCs.data()), blockCRCs.size() * 4);
+            }
         }
-        count++;
+        stats.items++;
     }
-    out.close();
-    std::cout << "[Pack] Done. Items: " << count << std::endl;
+
+    PackStats finish() {
+        if (streamMode) {
+            char endMark = static_cast<char>(PCK_TYPE_END);
+            cipher.apply(&endMark, 1);
+            emit(&endMark, 1);
+        }
+        return stats;
+    }
+};
+
+// 解包读取器核心: 解析包头，逐条解密/校验/解压后交给 visitor。
+// 返回受损条目数 (CRC 不符、坏块抢救、跳过、悬空引用)，由调用方决定是否算失败
+// - DUPLICATE: 去重引用，dupOf 为首份内容的相对路径，data 为空
+// - DELTA: 差量条目，data 为 basePathLen + basePath + 目标 CRC32 + 指令流，需要基准包才能还原
+enum class EntryKind {
+    NORMAL,
+    DUPLICATE,
+    DELTA
+};
+using EntryVisitor = std::function<void(const MemoryEntry& entry, EntryKind kind, const std::string* dupOf)>;
+
+size_t readPackEntries(std::istream& in, const std::string& password, const EntryVisitor& visit,
+                       const EngineLogger& log, const std::function<void(const PackHeader&)>& checkHeader = nullptr) {
+    const PackHeader header = readPackHeader(in);
+    if (checkHeader) checkHeader(header);
+    const bool isStream = header.isStream();
+    bool sawEnd = false;
+    size_t damaged = 0;
+
+    // 去重引用按包内偏移找首份内容，这里记下每个文件条目的偏移 -> 相对路径
+    std::unordered_map<uint64_t, std::string> extractedAt;
+    uint64_t entryOffset = header.size;
+
+    EntryHeader entry;
+    MemoryEntry out;
+    std::vector<char> fileData;
+    std::vector<char> decoded;
+    std::vector<uint32_t> blockCRCs;
+    std::vector<uint32_t> table;
+    withCipher(header.encMode, password, [&](auto& cipher) {
+        while (true) {
+            EntryRead status = readEntryHeader(in, cipher, header, entry);
+            if (status != EntryRead::OK) {
+                sawEnd = (status == EntryRead::END_MARK);
+                break;
+            }
+            const std::string& relPath = entry.relPath;
+            const uint64_t dataSize = entry.dataSize;
+            const uint8_t typeCode = entry.typeCode;
+            const Codec* decoder = (typeCode == PCK_TYPE_REF) ? nullptr : findCodec(entry.codec);
+            const bool encoded = decoder && decoder->decode;
+
+            fileData.resize(dataSize);
+            uint64_t tableSize = 0;
+            if (dataSize > 0) {
+                // 读入、分块 CRC (落盘字节)、解密、整条 CRC 在同一遍里逐块完成
+                uint32_t actualCRC = 0;
+                if (!openPayload(in, cipher, fileData.data(), dataSize, header.blockSize, blockCRCs, actualCRC)) {
+                    throw std::runtime_error("Truncated pack data: " + relPath);
+                }
+
+                // 对照分块 CRC 表定位损坏范围
+                std::vector<uint64_t> badBlocks;
+                if (header.hasBlockCRC()) {
+                    table.resize(blockCount(dataSize, header.blockSize));
+                    tableSize = table.size() * 4;
+                    in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(tableSize));
+                    if (!in) throw std::runtime_error("Truncated checksum table: " + relPath);
+                    for (uint64_t b = 0; b < table.size(); ++b) {
+                        if (blockCRCs[b] == table[b]) continue;
+                        badBlocks.push_back(b);
+                        uint64_t start = b * header.blockSize;
+                        uint64_t end = std::min<uint64_t>(start + header.blockSize, dataSize);
+                        log(LogLevel::ERROR, "[Error] Corrupted block: " + relPath + " stored bytes ["
+                                             + std::to_string(start) + ", " + std::to_string(end) + ")");
+                    }
+                }
+
+                if (badBlocks.empty()) {
+                    if (actualCRC != entry.crc) {
+                        log(LogLevel::ERROR, "[Error] CRC Mismatch: " + relPath);
+                        damaged++;
+                    }
+                } else if (typeCode == 1) {
+                    damaged++;
+                    // 抢救: 未压缩时把坏块清零，其余字节原样保留；
+                    // 压缩时坏块之后的解码位置不可信，只保留第一个坏块之前的部分
+                    if (encoded) {
+                        fileData.resize(badBlocks.front() * header.blockSize);
+                    } else {
+                        for (uint64_t b : badBlocks) {
+                            uint64_t start = b * header.blockSize;
+                            uint64_t end = std::min<uint64_t>(start + header.blockSize, dataSize);
+                            std::fill(fileData.begin() + start, fileData.begin() + end, 0);
+                        }
+                    }
+                    log(LogLevel::ERROR, "[Salvage] " + relPath + ": " + std::to_string(badBlocks.size())
+                                         + " bad block(s) " + (encoded ? "truncated" : "zero-filled"));
+                } else {
+                    log(LogLevel::ERROR, "[Error] Skip damaged entry: " + relPath);
+                    damaged++;
+                    entryOffset += entry.headerSize() + dataSize + tableSize;
+                    continue;
+                }
+
+                // 解码要等坏块定位之后才能决定抢救方式，所以单独一遍，结果换进 fileData 不再拷贝
+                if (encoded) {
+                    decoded.clear();
+                    decoder->decode(fileData.data(), fileData.size(), decoded);
+                    fileData.swap(decoded);
+                }
+            }
+
+            out.relPath = relPath;
+            out.data = fileData.data();
+            out.size = fileData.size();
+            out.mode = entry.meta.mode;
+            out.uid = entry.meta.uid;
+            out.gid = entry.meta.gid;
+            out.mtime = entry.meta.mtime;
+
+            if (typeCode == 1 || typeCode == 2 || typeCode == 3) {
+                out.type = (typeCode == 1 ? FileType::REGULAR : (typeCode == 2 ? FileType::DIRECTORY : FileType::SYMLINK));
+                visit(out, EntryKind::NORMAL, nullptr);
+                if (typeCode == 1 && header.hasDedup()) extractedAt.emplace(entryOffset, relPath);
+            } else if (typeCode == PCK_TYPE_REF) {
+                uint64_t refOffset = 0;
+                if (fileData.size() == 8) std::memcpy(&refOffset, fileData.data(), 8);
+                auto src = extractedAt.find(refOffset);
+                if (src == extractedAt.end()) {
+                    log(LogLevel::ERROR, "[Error] Dangling dedup reference: " + relPath);
+                    damaged++;
+                } else {
+                    out.type = FileType::REGULAR;
+                    out.data = nullptr;
+                    out.size = 0;
+                    visit(out, EntryKind::DUPLICATE, &src->second);
+                }
+            } else if (typeCode == PCK_TYPE_DELTA) {
+                out.type = FileType::REGULAR;
+                visit(out, EntryKind::DELTA, nullptr);
+            }
+
+            entryOffset += entry.headerSize() + dataSize + tableSize;
+        }
+    });
+
+    if (isStream && !sawEnd) throw std::runtime_error("Truncated pack stream: missing end marker");
+    return damaged;
+}
+
+// 包读完了但有受损条目: 能抢救的都已交出，仍要让调用方 (脚本看退出码) 知道结果不完整
+void throwIfDamaged(size_t damaged, const std::string& what) {
+    if (damaged == 0) return;
+    throw std::runtime_error(what + ": " + std::to_string(damaged) + " damaged entr"
+                             + (damaged == 1 ? "y" : "ies") + " salvaged or skipped (see log)");
+}
+
+// 打开单文件包或分卷包 (分卷除了包路径所在目录，还到 volumeDirs 里找)
+class ArchiveInput {
+    std::ifstream file;
+    std::unique_ptr<VolumeInBuf> volumes;
+    std::istream volumeStream{nullptr};
+
+public:
+    ArchiveInput(const std::string& path, const std::vector<std::string>& volumeDirs, const std::string& openError,
+                 size_t chunkSize = PIPE_CHUNK_SIZE) {
+        const std::vector<std::string> found = VolumeInBuf::locate(path, volumeDirs);
+        if (!found.empty()) {
+            volumes = std::make_unique<VolumeInBuf>(found, chunkSize);
+            volumeStream.rdbuf(volumes.get());
+            // 分卷缺失/读失败的原因从 underflow 的异常里带出来
+            volumeStream.exceptions(std::ios::badbit);
+            return;
+        }
+        file.open(fs::u8path(path), std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error(openError);
+    }
+
+    std::istream& stream() { return volumes ? volumeStream : file; }
+};
+
+// 读取基准包，为其中每个普通文件建立差量签名
+DeltaBase loadDeltaBase(const std::string& basePack, const std::vector<std::string>& volumeDirs,
+                        const std::string& password, const EngineLogger& log) {
+    ArchiveInput archive(basePack, volumeDirs, "Cannot open base pack file");
+    std::istream& in = archive.stream();
+
+    // 差量包的差量条目要靠更早的包才能还原，拿它做基准会把这些文件整份重存
+    auto checkHeader = [&basePack](const PackHeader& header) {
+        if (header.hasDelta()) {
+            throw std::runtime_error("Base pack is itself a delta pack, use a full pack as base: " + basePack);
+        }
+    };
+
+    DeltaBase base;
+    std::unordered_map<std::string, std::shared_ptr<const DeltaSignature>> byPath;
+    const size_t damaged = readPackEntries(in, password, [&](const MemoryEntry& e, EntryKind kind, const std::string* dupOf) {
+        if (kind == EntryKind::NORMAL && e.type == FileType::REGULAR) {
+            auto sig = std::make_shared<const DeltaSignature>(DeltaSignature::build(e.data, e.size));
+            byPath[e.relPath] = sig;
+            base[e.relPath] = {e.relPath, sig};
+        } else if (kind == EntryKind::DUPLICATE) {
+            auto src = byPath.find(*dupOf);
+            if (src != byPath.end()) base[e.relPath] = {*dupOf, src->second};
+        }
+    }, log, checkHeader);
+    // 按抢救出的内容算差量，解包时必然对不上，不如现在就停
+    throwIfDamaged(damaged, "Base pack is damaged");
+    return base;
+}
+
+// 拆出差量条目数据里的 basePath 和还原结果的 CRC，返回指令流的起始位置
+const char* splitDeltaPayload(const MemoryEntry& e, std::string& basePath, uint32_t& targetCRC) {
+    if (e.size < 12) throw std::runtime_error("Corrupted delta entry: " + e.relPath);
+    uint64_t len;
+    std::memcpy(&len, e.data, 8);
+    if (len > e.size - 12) throw std::runtime_error("Corrupted delta entry: " + e.relPath);
+    basePath.assign(e.data + 8, len);
+    std::memcpy(&targetCRC, e.data + 8 + len, 4);
+    return e.data + 12 + len;
+}
+
+// 打包 Files
+PackStats BackupEngine::packFiles(const FileList& files, std::ostream& out,
+                                  const std::string& password, EncryptionMode encMode,
+                                  CompressionMode compMode, const PackOptions& opts,
+                                  bool streamMode) const {
+    PackSink sink = [&out](const char* data, size_t size) {
+        out.write(data, static_cast<std::streamsize>(size));
+    };
+
+    DeltaBase deltaBase;
+    if (!opts.baseArchive.empty()) {
+        deltaBase = loadDeltaBase(opts.baseArchive, opts.volumeDirs, password, logger(streamMode));
+    }
+
+    PackStats stats = withCipher(encMode, password, [&](auto& cipher) {
+        PackWriter writer(sink, cipher, encMode, compMode, opts, streamMode,
+                          opts.baseArchive.empty() ? nullptr : &deltaBase);
+        for (const auto& rec : files) {
+            if (rec.type == FileType::REGULAR) writer.countSize(rec.size);
+        }
+
+        // 按窗口批量读: 窗口内的普通文件一次交给 I/O 后端，再按原顺序逐个写条目
+        std::unique_ptr<IoBackend> io = IoBackend::create(opts.ioBackend, config.threads, config.pool);
+        std::vector<FileRecord> window;
+        std::vector<ReadJob> jobs;
+        uint64_t windowBytes = 0;
+
+        EntryMeta meta;
+        std::vector<char> fileData;
+        auto flushWindow = [&] {
+            jobs.clear();
+            for (const auto& rec : window) {
+                if (rec.type == FileType::REGULAR) jobs.push_back(ReadJob{rec.absPath, {}, 0});
+            }
+            if (io) io->readFiles(jobs);
+
+            size_t next = 0;
+            for (const auto& rec : window) {
+                fileData.clear();
+                if (rec.type == FileType::REGULAR) {
+                    ReadJob& job = jobs[next++];
+                    if (io) {
+                        fileData.swap(job.data);
+                    } else {
+                        std::ifstream inFile(fs::u8path(rec.absPath), std::ios::binary);
+                        if (inFile) {
+                            fileData.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+                        }
+                    }
+                } else if (rec.type == FileType::SYMLINK) {
+                    fileData.assign(rec.linkTarget.begin(), rec.linkTarget.end());
+                }
+
+                meta.mode = rec.mode;
+                meta.uid = rec.uid;
+                meta.gid = rec.gid;
+                meta.mtime = rec.mtime;
+                writer.addEntry(rec.type, rec.relPath, meta, fileData);
+            }
+            window.clear();
+            windowBytes = 0;
+        };
+
+        for (const auto& rec : files) {
+            if (!window.empty() && (window.size() >= READ_BATCH_FILES || windowBytes + rec.size > READ_BATCH_BYTES)) {
+                flushWindow();
+            }
+            window.push_back(rec);
+            if (rec.type == FileType::REGULAR) windowBytes += rec.size;
+        }
+        flushWindow();
+
+        return writer.finish();
+    });
+    out.flush();
+    if (!out) throw std::runtime_error("Write pack data failed");
+    return stats;
+}
+
+// 内存打包: 条目来自调用方的缓冲区，编码结果交给 sink (流式格式)
+PackStats BackupEngine::packMemory(const std::vector<MemoryEntry>& entries, const PackSink& sink,
+                                   const std::string& password, EncryptionMode encMode,
+                                   CompressionMode compMode, const PackOptions& opts) const {
+    if (opts.volumeSize != 0) throw std::runtime_error("Volumes are not supported for memory packs");
+
+    DeltaBase deltaBase;
+    if (!opts.baseArchive.empty()) {
+        deltaBase = loadDeltaBase(opts.baseArchive, opts.volumeDirs, password, logger());
+    }
+
+    PackStats stats = withCipher(encMode, password, [&](auto& cipher) {
+        PackWriter writer(sink, cipher, encMode, compMode, opts, true,
+                          opts.baseArchive.empty() ? nullptr : &deltaBase);
+        for (const auto& e : entries) {
+            if (e.type == FileType::REGULAR) writer.countSize(e.size);
+        }
+
+        EntryMeta meta;
+        std::vector<char> fileData;
+        for (const auto& e : entries) {
+            // 压缩/加密都是就地进行的，这里必须拷一份，调用方的缓冲区保持只读
+            if (e.type == FileType::DIRECTORY || e.data == nullptr) fileData.clear();
+            else fileData.assign(e.data, e.data + e.size);
+
+            meta.mode = e.mode;
+            meta.uid = e.uid;
+            meta.gid = e.gid;
+            meta.mtime = e.mtime;
+            writer.addEntry(e.type, e.relPath, meta, fileData);
+        }
+        return writer.finish();
+    });
+    if (config.statsSink) config.statsSink(stats);
+    return stats;
 }
 
 void BackupEngine::pack(const std::string& srcPath, const std::string& outputFile,
                         const std::string& password, const EncryptionMode encMode,
-                        const FilterOptions& filter, const CompressionMode compMode) {
+                        const FilterOptions& filter, const CompressionMode compMode,
+                        const PackOptions& opts) const {
     auto files = scanDirectory(srcPath, filter);
-    packFiles(files, outputFile, password, encMode, compMode);
+
+    auto report = [this](const EngineLogger& log, const PackStats& stats) {
+        log(LogLevel::INFO, "[Pack] Done. Items: " + std::to_string(stats.items));
+        if (stats.dedupRefs > 0) {
+            log(LogLevel::INFO, "[Pack] Dedup: " + std::to_string(stats.dedupRefs) + " duplicate(s), "
+                                + std::to_string(stats.dedupBytes) + " bytes saved");
+        }
+        if (stats.compressedEntries > 0) {
+            log(LogLevel::INFO, "[Pack] Compressed: " + std::to_string(stats.compressedEntries) + " entries");
+        }
+        if (stats.deltaEntries > 0) {
+            log(LogLevel::INFO, "[Pack] Delta: " + std::to_string(stats.deltaEntries) + " file(s) stored as delta, "
+                                + std::to_string(stats.deltaBytes) + " bytes saved");
+        }
+        if (config.statsSink) config.statsSink(stats);
+    };
+
+    if (outputFile == "-") {
+        if (opts.volumeSize != 0) throw std::runtime_error("Volumes cannot be written to stdout");
+        // stdout 被数据占用，日志改走 stderr
+        FdOutBuf pipeBuf(1, config.ioBufferSize);
+        std::ostream out(&pipeBuf);
+        report(logger(true), packFiles(files, out, password, encMode, compMode, opts, true));
+        return;
+    }
+
+    if (opts.volumeSize != 0) {
+        // 分卷用流式格式: 没有卷数记录，靠结束标记发现缺了末尾的卷
+        VolumeOutBuf volumes(outputFile, opts.volumeSize, opts.volumeDirs, config.ioBufferSize,
+                             opts.volumeQueueSize);
+        std::ostream out(&volumes);
+        PackStats stats = packFiles(files, out, password, encMode, compMode, opts, true);
+        volumes.close();
+        const EngineLogger log = logger();
+        report(log, stats);
+        log(LogLevel::INFO, "[Pack] Volumes: " + std::to_string(volumes.volumeCount()));
+        return;
+    }
+
+    std::ofstream out(fs::u8path(outputFile), std::ios::binary);
+    if (!out.is_open()) throw std::runtime_error("Cannot create pack file");
+    PackStats stats = packFiles(files, out, password, encMode, compMode, opts, false);
+    out.close();
+    report(logger(), stats);
 }
 
 // 解包
-void BackupEngine::unpack(const std::string& packFile, const std::string& destPath, const std::string& password) {
-    std::ifstream in(fs::u8path(packFile), std::ios::binary);
-    if (!in.is_open()) throw std::runtime_error("Cannot open pack file");
+void BackupEngine::unpack(const std::string& packFile, const std::string& destPath, const std::string& password,
+                          const UnpackOptions& opts) const {
+    if (packFile == "-") {
+        FdInBuf pipeBuf(0, config.ioBufferSize);
+        std::istream in(&pipeBuf);
+        unpackStream(in, destPath, password, opts);
+        return;
+    }
 
-    fs::path destRoot = fs::u8path(destPath);
-    if (!fs::exists(destRoot)) fs::create_directories(destRoot);
+    ArchiveInput archive(packFile, opts.volumeDirs, "Cannot open pack file", config.ioBufferSize);
+    unpackStream(archive.stream(), destPath, password, opts);
+}
 
-    char magic[9] = {0};
-    in.read(magic, 8);
-    std::string magicStr(magic);
+void BackupEngine::unpackStream(std::istream& in, const std::string& destPath, const std::string& password,
+                                const UnpackOptions& opts) const {
+    const EngineLogger log = logger();
+    RestoreWriter writer(fs::u8path(destPath), opts.directIoMinSize, opts.ioBackend, config.threads, config.pool);
+
+    // 差量条目先攒着 (只有指令流，体积约等于改动量)，等第二遍读基准包时按 basePath 还原
+    struct PendingDelta {
+        std::string relPath;
+        EntryMeta meta;
+        uint32_t targetCRC;
+        std::vector<char> ops;
+    };
+    std::unordered_multimap<std::string, PendingDelta> pending;
+
+    auto toMeta = [](const MemoryEntry& e) {
+        EntryMeta meta;
+        meta.mode = e.mode;
+        meta.uid = e.uid;
+        meta.gid = e.gid;
+        meta.mtime = e.mtime;
+        return meta;
+    };
 
-    auto encMode = EncryptionMode::NONE;
-    if (magicStr == "MINIBK_R") encMode = EncryptionMode::RC4;
-    else if (magicStr == "MINIBK_X") encMode = EncryptionMode::XOR;
-    else if (magicStr != "MINIBK10") throw std::runtime_error("Unknown file format");
+    // 差量包没给基准包时，在写出任何文件之前就失败
+    auto checkHeader = [&opts](const PackHeader& header) {
+        if (header.hasDelta() && opts.baseArchive.empty()) {
+            throw std::runtime_error("Delta pack requires a base pack (-base)");
+        }
+    };
 
-    char compFlag = 0;
-    in.read(&compFlag, 1);
-    bool isRLE = (compFlag == 1);
-
-    RC4 rc4;
-    if (encMode == EncryptionMode::RC4) rc4.init(password);
-
-    while (in.peek() != EOF) {
-        char typeBuf[1]; in.read(typeBuf, 1);
-        if (in.gcount() == 0) break;
-        if (encMode == EncryptionMode::RC4) rc4.cipher(typeBuf, 1);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(typeBuf, 1, password);
-        uint8_t typeCode = static_cast<uint8_t>(typeBuf[0]);
-
-        char lenBuf[8]; in.read(lenBuf, 8);
-        if (encMode == EncryptionMode::RC4) rc4.cipher(lenBuf, 8);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(lenBuf, 8, password);
-        uint64_t pathLen = *reinterpret_cast<uint64_t*>(lenBuf);
-
-        std::vector<char> pathBuf(pathLen);
-        in.read(pathBuf.data(), pathLen);
-        if (encMode == EncryptionMode::RC4) rc4.cipher(pathBuf.data(), pathLen);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(pathBuf.data(), pathLen, password);
-        std::string relPath(pathBuf.begin(), pathBuf.end());
-
-        char sizeBuf[8]; in.read(sizeBuf, 8);
-        if (encMode == EncryptionMode::RC4) rc4.cipher(sizeBuf, 8);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(sizeBuf, 8, password);
-        uint64_t dataSize = *reinterpret_cast<uint64_t*>(sizeBuf);
-
-        char crcBuf[4]; in.read(crcBuf, 4);
-        if (encMode == EncryptionMode::RC4) rc4.cipher(crcBuf, 4);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(crcBuf, 4, password);
-        uint32_t expectedCRC = *reinterpret_cast<uint32_t*>(crcBuf);
-
-        char metaBlock[20]; in.read(metaBlock, 20);
-        if (encMode == EncryptionMode::RC4) rc4.cipher(metaBlock, 20);
-        else if (encMode == EncryptionMode::XOR) xorEncrypt(metaBlock, 20, password);
-
-        uint32_t f_mode = *reinterpret_cast<uint32_t*>(metaBlock);
-        uint32_t f_uid  = *reinterpret_cast<uint32_t*>(metaBlock + 4);
-        uint32_t f_gid  = *reinterpret_cast<uint32_t*>(metaBlock + 8);
-        int64_t f_mtime = *reinterpret_cast<int64_t*>(metaBlock + 12);
-
-        fs::path fullPath = destRoot / fs::u8path(relPath);
-        std::vector<char> fileData(dataSize);
-        if (dataSize > 0) {
-            in.read(fileData.data(), dataSize);
-            if (encMode == EncryptionMode::RC4) rc4.cipher(fileData.data(), dataSize);
-            else if (encMode == EncryptionMode::XOR) xorEncrypt(fileData.data(), dataSize, password);
-
-            uint32_t actualCRC = CRC32::calculate(fileData.data(), dataSize);
-            if (actualCRC != expectedCRC) {
-                std::cerr << "[Error] CRC Mismatch: " << relPath << std::endl;
+    const size_t damaged = readPackEntries(in, password, [&](const MemoryEntry& e, EntryKind kind, const std::string* dupOf) {
+        const EntryMeta meta = toMeta(e);
+        if (kind == EntryKind::DUPLICATE) {
+            writer.copyFile(*dupOf, e.relPath, meta);
+        } else if (kind == EntryKind::DELTA) {
+            std::string basePath;
+            uint32_t targetCRC = 0;
+            const char* ops = splitDeltaPayload(e, basePath, targetCRC);
+            pending.emplace(basePath, PendingDelta{e.relPath, meta, targetCRC, std::vector<char>(ops, e.data + e.size)});
+        } else if (e.type == FileType::DIRECTORY) {
+            writer.makeDirectory(e.relPath, meta);
+        } else if (e.type == FileType::SYMLINK) {
+            writer.makeSymlink(e.relPath, std::string(e.data, e.size), meta);
+        } else {
+            writer.writeFile(e.relPath, e.data, e.size, meta);
+        }
+    }, log, checkHeader);
+
+    // 基准包里只有差量用到的文件才要紧，其中的损坏由还原结果的 CRC 查出，不另计
+    if (!pending.empty()) {
+        if (opts.baseArchive.empty()) throw std::runtime_error("Delta pack requires a base pack (-base)");
+
+        ArchiveInput baseArchive(opts.baseArchive, opts.volumeDirs, "Cannot open base pack file",
+                                 config.ioBufferSize);
+        std::istream& baseIn = baseArchive.stream();
+
+        std::vector<char> rebuilt;
+        size_t failed = 0;
+        readPackEntries(baseIn, password, [&](const MemoryEntry& e, EntryKind kind, const std::string*) {
+            if (kind != EntryKind::NORMAL || e.type != FileType::REGULAR) return;
+            auto range = pending.equal_range(e.relPath);
+            for (auto it = range.first; it != range.second; ++it) {
+                const PendingDelta& d = it->second;
+                bool ok = true;
+                try {
+                    applyDelta(e.data, e.size, d.ops.data(), d.ops.size(), rebuilt);
+                } catch (const std::exception&) {
+                    ok = false;
+                }
+                if (!ok || CRC32::calculate(rebuilt.data(), rebuilt.size()) != d.targetCRC) {
+                    log(LogLevel::ERROR, "[Error] Delta base mismatch: " + d.relPath + " (base: " + e.relPath + ")");
+                    failed++;
+                    continue;
+                }
+                writer.writeFile(d.relPath, rebuilt.data(), rebuilt.size(), d.meta);
             }
-
-            if (isRLE) {
-                std::vector<char> dec;
-                rleDecompress(fileData, dec);
-                fileData = dec;
+            pending.erase(range.first, range.second);
+        }, log, [&opts](const PackHeader& header) {
+            if (header.hasDelta()) {
+                throw std::runtime_error("Base pack is itself a delta pack, use a full pack as base: " + opts.baseArchive);
             }
-        }
+        });
 
-        if (typeCode == 2) {
-            fs::create_directories(fullPath);
-        } else if (typeCode == 3) {
-            std::string target(fileData.begin(), fileData.end());
-            if (fullPath.has_parent_path()) fs::create_directories(fullPath.parent_path());
-            if (fs::exists(fullPath) || fs::is_symlink(fullPath)) fs::remove(fullPath);
-            try { fs::create_symlink(target, fullPath); } catch(...) {}
-        } else if (typeCode == 1) {
-            if (fullPath.has_parent_path()) fs::create_directories(fullPath.parent_path());
-            std::ofstream outFile(fullPath, std::ios::binary);
-            outFile.write(fileData.data(), fileData.size());
+        for (const auto& kv : pending) {
+            log(LogLevel::ERROR, "[Error] Base file not found for delta: " + kv.second.relPath
+                                 + " (base: " + kv.first + ")");
+        }
+        failed += pending.size();
+        if (failed > 0) {
+            writer.finish();
+            throw std::runtime_error("Delta unpack failed: " + std::to_string(failed) + " file(s) could not be rebuilt");
         }
-
-        try {
-#ifdef _WIN32
-            struct __utimbuf64 new_times{}; // 双下划线
-            new_times.actime = f_mtime;
-            new_times.modtime = f_mtime;
-            _wutime64(fullPath.c_str(), &new_times);
-#else
-            chmod(fullPath.c_str(), f_mode);
-            chown(fullPath.c_str(), f_uid, f_gid);
-            struct utimbuf new_times{};
-            new_times.actime = f_mtime;
-            new_times.modtime = f_mtime;
-            utime(fullPath.c_str(), &new_times);
-#endif
-        } catch (...) {}
     }
-}
\ No newline at end of file
+
+    writer.finish();
+    throwIfDamaged(damaged, "Unpack incomplete");
+}
+
+// 内存解包: 直接在调用方的缓冲区上解析，不落盘
+void BackupEngine::unpackMemory(const char* data, size_t size, const UnpackVisitor& visitor,
+                                const std::string& password) const {
+    SpanInBuf span(data, size);
+    std::istream in(&span);
+
+    // 去重引用需要交出首份内容，首份内容的解码结果在这里留一份
+    std::unordered_map<std::string, std::vector<char>> firstCopies;
+    bool keepCopies = (size > PCK_HEADER_SIZE) && (data[8] & PCK_FLAG_DEDUP);
+
+    const size_t damaged = readPackEntries(in, password, [&](const MemoryEntry& e, EntryKind kind, const std::string* dupOf) {
+        if (kind == EntryKind::DELTA) throw std::runtime_error("Delta entry needs a base pack: " + e.relPath);
+        if (!dupOf) {
+            if (keepCopies && e.type == FileType::REGULAR) firstCopies[e.relPath].assign(e.data, e.data + e.size);
+            visitor(e);
+            return;
+        }
+        const std::vector<char>& src = firstCopies[*dupOf];
+        MemoryEntry dup = e;
+        dup.data = src.data();
+        dup.size = src.size();
+        visitor(dup);
+    }, logger());
+    throwIfDamaged(damaged, "Unpack incomplete");
+}
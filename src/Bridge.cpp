@@ -1,7 +1,12 @@
 // src/Bridge.cpp
 #include "BackupEngine.h"
+#include "Pipeline.h"
+#include "ThreadPool.h"
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 // === 跨平台导出宏定义 ===
 #ifdef _WIN32
@@ -22,6 +27,146 @@ struct CFilter {
     int targetUid;
 };
 
+// 内存条目 (与 Python ctypes 结构体一一对应，字段自然对齐，无隐式填充)
+struct CMemEntry {
+    const char* relPath;
+    const char* data;
+    unsigned long long size;
+    int type;            // 0=File, 1=Dir, 2=Link
+    unsigned int mode;
+    unsigned int uid;
+    unsigned int gid;
+    long long mtime;
+};
+
+// 回调返回 0 表示调用方要求中止
+typedef int (*CSinkFn)(void* ctx, const char* data, unsigned long long size);
+typedef int (*CVisitFn)(void* ctx, const CMemEntry* entry);
+
+// 日志回调: level 0=INFO, 1=ERROR。可能在任意工作线程上被调用
+typedef void (*CLogFn)(void* ctx, int level, const char* message);
+
+// codec 回调: 结果写入 out (容量 capacity)，返回结果长度；长度超过 capacity 时会换足够大的缓冲区再调一次
+typedef unsigned long long (*CCodecFn)(void* ctx, const char* data, unsigned long long size,
+                                       char* out, unsigned long long capacity);
+// 估计编码结果占原文大小的比例 (AUTO 模式挑 codec 用)
+typedef double (*CEstimateFn)(void* ctx, const char* data, unsigned long long size);
+
+// 打包统计 (与 Python ctypes 结构体一一对应)
+struct CPackStats {
+    int items;
+    int dedupRefs;
+    int deltaEntries;
+    int compressedEntries;
+    unsigned long long dedupBytes;
+    unsigned long long deltaBytes;
+};
+
+// 打包选项 (与 Python ctypes 结构体一一对应)，对应 PackOptions
+struct CPackOptions {
+    int dedup;                      // 非 0 时整文件去重
+    unsigned int checksumBlockSize; // 分块校验块大小 (4096 的整数倍)，0 表示不启用
+    const char* baseArchive;        // 差量打包的基准包 (单文件或分卷)，NULL 表示不启用
+};
+
+// 解包选项 (与 Python ctypes 结构体一一对应)，对应 UnpackOptions
+struct CUnpackOptions {
+    const char* baseArchive;        // 差量包的基准包，NULL 表示没有
+};
+
+// 引擎句柄: 每个任务一个，结果字符串和统计挂在句柄上，不同句柄可在不同线程并发使用；
+// 同一句柄上的调用需要调用方自己串行 (返回的字符串在下一次调用前有效)
+struct CEngine {
+    std::unique_ptr<BackupEngine> engine;
+    std::string lastMessage; // verify 结果或最近一次的异常信息
+    PackStats lastStats;
+    CLogFn logFn = nullptr;
+    void* logCtx = nullptr;
+};
+
+// 进程内所有句柄共享一个线程池，首次使用时创建
+static ThreadPool& sharedPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// 旧的无句柄接口共用的默认引擎 (引擎方法都是 const 的，可并发调用)
+static const BackupEngine& defaultEngine() {
+    static const BackupEngine engine([] {
+        EngineConfig config;
+        config.pool = &sharedPool();
+        return config;
+    }());
+    return engine;
+}
+
+static EncryptionMode toEncryption(int encMode) {
+    if (encMode == 1) return EncryptionMode::XOR;
+    if (encMode == 2) return EncryptionMode::RC4;
+    return EncryptionMode::NONE;
+}
+
+static CompressionMode toCompression(int compMode) {
+    if (compMode == 1) return CompressionMode::RLE;
+    if (compMode == 2) return CompressionMode::AUTO;
+    return CompressionMode::NONE;
+}
+
+static FilterOptions toFilter(const CFilter* c_filter) {
+    FilterOptions opts;
+    if (!c_filter) return opts;
+    if (c_filter->nameContains) opts.nameContains = c_filter->nameContains;
+    if (c_filter->pathContains) opts.pathContains = c_filter->pathContains;
+    opts.type = c_filter->type;
+    opts.minSize = c_filter->minSize;
+    opts.maxSize = c_filter->maxSize;
+    opts.startTime = c_filter->startTime;
+    opts.targetUid = c_filter->targetUid;
+    return opts;
+}
+
+static PackOptions toPackOptions(const CPackOptions* c_opts) {
+    PackOptions opts;
+    if (!c_opts) return opts;
+    opts.dedup = c_opts->dedup != 0;
+    opts.checksumBlockSize = c_opts->checksumBlockSize;
+    if (c_opts->baseArchive) opts.baseArchive = c_opts->baseArchive;
+    return opts;
+}
+
+static UnpackOptions toUnpackOptions(const CUnpackOptions* c_opts) {
+    UnpackOptions opts;
+    if (!c_opts) return opts;
+    if (c_opts->baseArchive) opts.baseArchive = c_opts->baseArchive;
+    return opts;
+}
+
+// 把 C 回调包装成 Codec 的整条目编解码
+static std::function<void(const char*, size_t, std::vector<char>&)> wrapCodecFn(CCodecFn fn, void* ctx) {
+    return [fn, ctx](const char* data, size_t size, std::vector<char>& out) {
+        out.resize(size + 64);
+        unsigned long long n = fn(ctx, data, size, out.data(), out.size());
+        if (n > out.size()) {
+            out.resize(n);
+            n = fn(ctx, data, size, out.data(), out.size());
+            if (n > out.size()) throw std::runtime_error("Codec output size changed between calls");
+        }
+        out.resize(n);
+    };
+}
+
+static FileType toFileType(int type) {
+    if (type == 1) return FileType::DIRECTORY;
+    if (type == 2) return FileType::SYMLINK;
+    return FileType::REGULAR;
+}
+
+static int fromFileType(FileType type) {
+    if (type == FileType::DIRECTORY) return 1;
+    if (type == FileType::SYMLINK) return 2;
+    return 0;
+}
+
 extern "C" {
 
     // ==========================================
@@ -31,7 +176,7 @@ extern "C" {
     // [修改] 改名为 C_BackupSimple
     LIBRARY_API int C_BackupSimple(const char* src, const char* dest) {
         try {
-            BackupEngine::backup(src, dest);
+            defaultEngine().backup(src, dest);
             return 1;
         } catch (...) { return 0; }
     }
@@ -39,7 +184,7 @@ extern "C" {
     // [修改] 改名为 C_RestoreSimple
     LIBRARY_API int C_RestoreSimple(const char* src, const char* dest) {
         try {
-            BackupEngine::restore(src, dest);
+            defaultEngine().restore(src, dest);
             return 1;
         } catch (...) { return 0; }
     }
@@ -47,15 +192,26 @@ extern "C" {
     // [修改] 改名为 C_VerifySimple
     LIBRARY_API const char* C_VerifySimple(const char* dest) {
         try {
-            // 使用 static，让它在函数结束后依然存在
-            static std::string g_lastVerifyMsg;
-            g_lastVerifyMsg = BackupEngine::verify(dest);
+            // thread_local: 函数返回后依然存在，且不同线程的结果互不覆盖
+            thread_local std::string g_lastVerifyMsg;
+            g_lastVerifyMsg = defaultEngine().verify(dest);
             return g_lastVerifyMsg.c_str();
         } catch (...) {
             return "发生未知异常";
         }
     }
 
+    // 包校验: 返回空串表示通过
+    LIBRARY_API const char* C_VerifyPack(const char* pckFile, const char* pwd) {
+        try {
+            thread_local std::string g_lastVerifyPackMsg;
+            g_lastVerifyPackMsg = defaultEngine().verifyPack(pckFile, pwd ? pwd : "");
+            return g_lastVerifyPackMsg.c_str();
+        } catch (...) {
+            return "发生未知异常";
+        }
+    }
+
     // ==========================================
     // 2. 高级模式接口 (演示视频 Tab 2 & 3 用)
     // ==========================================
@@ -69,35 +225,12 @@ extern "C" {
             std::cout << "\n=== [C++ Bridge Debug] ===" << std::endl;
             std::cout << "源路径: " << src << std::endl;
 
-            auto cppEnc = EncryptionMode::NONE;
-            if (encMode == 1) cppEnc = EncryptionMode::XOR;
-            else if (encMode == 2) cppEnc = EncryptionMode::RC4;
-
-            auto cppComp = CompressionMode::NONE;
-            if (compMode == 1) cppComp = CompressionMode::RLE;
-
-            FilterOptions opts;
+            FilterOptions opts = toFilter(c_filter);
             if (c_filter) {
                 // 打印调试信息，看看 C++ 到底收到了什么
                 std::cout << "接收筛选器配置:" << std::endl;
-
-                if (c_filter->nameContains) {
-                    opts.nameContains = c_filter->nameContains;
-                    std::cout << "  - 名字含: " << opts.nameContains << std::endl;
-                }
-
-                // 路径筛选
-                if (c_filter->pathContains) {
-                    opts.pathContains = c_filter->pathContains;
-                    std::cout << "  - 路径含: " << opts.pathContains << std::endl;
-                }
-
-                opts.type = c_filter->type;
-                opts.minSize = c_filter->minSize;
-                opts.maxSize = c_filter->maxSize;
-                opts.startTime = c_filter->startTime;
-                opts.targetUid = c_filter->targetUid;
-
+                if (!opts.nameContains.empty()) std::cout << "  - 名字含: " << opts.nameContains << std::endl;
+                if (!opts.pathContains.empty()) std::cout << "  - 路径含: " << opts.pathContains << std::endl;
                 std::cout << "  - 最小大小: " << opts.minSize << std::endl;
                 std::cout << "  - 最大大小: " << opts.maxSize << std::endl;
                 std::cout << "  - 起始时间戳: " << opts.startTime << std::endl;
@@ -106,7 +239,7 @@ extern "C" {
             }
             std::cout << "==========================\n" << std::endl;
 
-            BackupEngine::pack(src, pckFile, pwd, cppEnc, opts, cppComp);
+            defaultEngine().pack(src, pckFile, pwd, toEncryption(encMode), opts, toCompression(compMode));
             return 1;
         } catch (const std::exception& e) {
             std::cerr << "C++ Exception: " << e.what() << std::endl;
@@ -119,8 +252,277 @@ extern "C" {
     // 解包接口
     LIBRARY_API int C_Unpack(const char* pckFile, const char* dest, const char* pwd) {
         try {
-            BackupEngine::unpack(pckFile, dest, pwd);
+            defaultEngine().unpack(pckFile, dest, pwd);
             return 1;
         } catch (...) { return 0; }
     }
-}
\ No newline at end of file
+
+    // ==========================================
+    // 3. 内存接口 (不经过临时文件，缓冲区零拷贝传入)
+    // ==========================================
+
+    // 内存打包: entries 的 data 直接引用调用方缓冲区，编码结果分段交给 sink
+    // c_opts 可为 NULL (默认选项)
+    LIBRARY_API int C_PackMemoryEx(const CMemEntry* entries, int count, const char* pwd,
+                                   int encMode, int compMode, const CPackOptions* c_opts, CSinkFn sink, void* ctx) {
+        try {
+            if (!sink || (count > 0 && !entries)) return 0;
+
+            std::vector<MemoryEntry> list(count);
+            for (int k = 0; k < count; ++k) {
+                list[k].relPath = entries[k].relPath ? entries[k].relPath : "";
+                list[k].type = toFileType(entries[k].type);
+                list[k].data = entries[k].data;
+                list[k].size = entries[k].size;
+                list[k].mode = entries[k].mode;
+                list[k].uid = entries[k].uid;
+                list[k].gid = entries[k].gid;
+                list[k].mtime = entries[k].mtime;
+            }
+
+            defaultEngine().packMemory(list, [&](const char* data, size_t size) {
+                if (!sink(ctx, data, size)) throw std::runtime_error("Aborted by sink");
+            }, pwd ? pwd : "", toEncryption(encMode), toCompression(compMode), toPackOptions(c_opts));
+            return 1;
+        } catch (const std::exception& e) {
+            std::cerr << "C++ Exception: " << e.what() << std::endl;
+            return 0;
+        } catch (...) {
+            return 0;
+        }
+    }
+
+    LIBRARY_API int C_PackMemory(const CMemEntry* entries, int count, const char* pwd,
+                                 int encMode, int compMode, CSinkFn sink, void* ctx) {
+        return C_PackMemoryEx(entries, count, pwd, encMode, compMode, nullptr, sink, ctx);
+    }
+
+    // 内存解包: 直接解析 [data, data + size)，每个条目回调一次 visit (data 只在回调期间有效)
+    LIBRARY_API int C_UnpackMemory(const char* data, unsigned long long size, const char* pwd,
+                                   CVisitFn visit, void* ctx) {
+        try {
+            if (!data || !visit) return 0;
+            defaultEngine().unpackMemory(data, size, [&](const MemoryEntry& e) {
+                CMemEntry c{};
+                c.relPath = e.relPath.c_str();
+                c.data = e.data;
+                c.size = e.size;
+                c.type = fromFileType(e.type);
+                c.mode = e.mode;
+                c.uid = e.uid;
+                c.gid = e.gid;
+                c.mtime = e.mtime;
+                if (!visit(ctx, &c)) throw std::runtime_error("Aborted by visitor");
+            }, pwd ? pwd : "");
+            return 1;
+        } catch (const std::exception& e) {
+            std::cerr << "C++ Exception: " << e.what() << std::endl;
+            return 0;
+        } catch (...) {
+            return 0;
+        }
+    }
+
+    // ==========================================
+    // 4. 句柄接口 (同一进程内并发跑多个独立任务)
+    // ==========================================
+
+    // 创建引擎句柄，log 为空时日志写 stdout/stderr
+    LIBRARY_API CEngine* C_EngineCreate(CLogFn log, void* ctx) {
+        try {
+            auto* h = new CEngine();
+            h->logFn = log;
+            h->logCtx = ctx;
+
+            EngineConfig config;
+            config.pool = &sharedPool();
+            if (log) {
+                config.logger = [h](LogLevel level, const std::string& message) {
+                    h->logFn(h->logCtx, level == LogLevel::ERROR ? 1 : 0, message.c_str());
+                };
+            }
+            config.statsSink = [h](const PackStats& stats) { h->lastStats = stats; };
+            h->engine = std::make_unique<BackupEngine>(std::move(config));
+            return h;
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    LIBRARY_API void C_EngineDestroy(CEngine* h) {
+        delete h;
+    }
+
+    // 返回空串表示通过；句柄无效或出现异常时返回非空的错误信息
+    LIBRARY_API const char* C_EngineVerifyPack(CEngine* h, const char* pckFile, const char* pwd) {
+        if (!h || !pckFile) return "无效参数";
+        try {
+            h->lastMessage = h->engine->verifyPack(pckFile, pwd ? pwd : "");
+        } catch (const std::exception& e) {
+            h->lastMessage = std::string("发生异常: ") + e.what();
+        }
+        return h->lastMessage.c_str();
+    }
+
+    LIBRARY_API const char* C_EngineVerify(CEngine* h, const char* dest) {
+        if (!h || !dest) return "无效参数";
+        try {
+            h->lastMessage = h->engine->verify(dest);
+        } catch (const std::exception& e) {
+            h->lastMessage = std::string("发生异常: ") + e.what();
+        }
+        return h->lastMessage.c_str();
+    }
+
+    LIBRARY_API int C_EnginePack(CEngine* h, const char* src, const char* pckFile, const char* pwd,
+                                 int encMode, const CFilter* c_filter, int compMode) {
+        if (!h || !src || !pckFile) return 0;
+        try {
+            h->lastMessage.clear();
+            h->engine->pack(src, pckFile, pwd ? pwd : "", toEncryption(encMode), toFilter(c_filter),
+                            toCompression(compMode));
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 带打包选项的打包: c_opts 为 NULL 时等同 C_EnginePack
+    LIBRARY_API int C_EnginePackEx(CEngine* h, const char* src, const char* pckFile, const char* pwd,
+                                   int encMode, const CFilter* c_filter, int compMode, const CPackOptions* c_opts) {
+        if (!h || !src || !pckFile) return 0;
+        try {
+            h->lastMessage.clear();
+            h->engine->pack(src, pckFile, pwd ? pwd : "", toEncryption(encMode), toFilter(c_filter),
+                            toCompression(compMode), toPackOptions(c_opts));
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    LIBRARY_API int C_EngineUnpack(CEngine* h, const char* pckFile, const char* dest, const char* pwd) {
+        if (!h || !pckFile || !dest) return 0;
+        try {
+            h->lastMessage.clear();
+            h->engine->unpack(pckFile, dest, pwd ? pwd : "");
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 带解包选项的解包 (差量包传基准包): c_opts 为 NULL 时等同 C_EngineUnpack
+    LIBRARY_API int C_EngineUnpackEx(CEngine* h, const char* pckFile, const char* dest, const char* pwd,
+                                     const CUnpackOptions* c_opts) {
+        if (!h || !pckFile || !dest) return 0;
+        try {
+            h->lastMessage.clear();
+            h->engine->unpack(pckFile, dest, pwd ? pwd : "", toUnpackOptions(c_opts));
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 分卷打包: 每卷最多 volumeSize 字节，dirs[0..dirCount) 非空时分卷轮流写到这些目录
+    LIBRARY_API int C_EnginePackVolumes(CEngine* h, const char* src, const char* pckFile, const char* pwd,
+                                        int encMode, const CFilter* c_filter, int compMode,
+                                        unsigned long long volumeSize, const char* const* dirs, int dirCount) {
+        if (!h || !src || !pckFile || volumeSize == 0) return 0;
+        try {
+            h->lastMessage.clear();
+            PackOptions opts;
+            opts.volumeSize = volumeSize;
+            for (int i = 0; dirs && i < dirCount; ++i) opts.volumeDirs.emplace_back(dirs[i]);
+            h->engine->pack(src, pckFile, pwd ? pwd : "", toEncryption(encMode), toFilter(c_filter),
+                            toCompression(compMode), opts);
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 解包分卷散落在多个目录的包: 除了 pckFile 所在目录，还到 dirs 里找分卷
+    LIBRARY_API int C_EngineUnpackVolumes(CEngine* h, const char* pckFile, const char* dest, const char* pwd,
+                                          const char* const* dirs, int dirCount) {
+        if (!h || !pckFile || !dest) return 0;
+        try {
+            h->lastMessage.clear();
+            UnpackOptions opts;
+            for (int i = 0; dirs && i < dirCount; ++i) opts.volumeDirs.emplace_back(dirs[i]);
+            h->engine->unpack(pckFile, dest, pwd ? pwd : "", opts);
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 从镜像恢复: differential 非 0 时只改写有差异的文件，deleteExtra 非 0 时删除目标里多余的条目
+    LIBRARY_API int C_EngineRestore(CEngine* h, const char* src, const char* dest, int differential,
+                                    int deleteExtra) {
+        if (!h || !src || !dest) return 0;
+        try {
+            h->lastMessage.clear();
+            RestoreOptions opts;
+            opts.differential = differential != 0 || deleteExtra != 0;
+            opts.deleteExtra = deleteExtra != 0;
+            h->engine->restore(src, dest, opts);
+            return 1;
+        } catch (const std::exception& e) {
+            h->lastMessage = e.what();
+            return 0;
+        }
+    }
+
+    // 最近一次 C_EnginePack / C_EngineUnpack / C_EngineRestore 失败的原因
+    LIBRARY_API const char* C_EngineLastError(CEngine* h) {
+        return h ? h->lastMessage.c_str() : "";
+    }
+
+    // 最近一次打包的统计
+    LIBRARY_API int C_EngineLastStats(CEngine* h, CPackStats* out) {
+        if (!h || !out) return 0;
+        out->items = h->lastStats.items;
+        out->dedupRefs = h->lastStats.dedupRefs;
+        out->deltaEntries = h->lastStats.deltaEntries;
+        out->compressedEntries = h->lastStats.compressedEntries;
+        out->dedupBytes = h->lastStats.dedupBytes;
+        out->deltaBytes = h->lastStats.deltaBytes;
+        return 1;
+    }
+
+    // ==========================================
+    // 5. codec 扩展
+    // ==========================================
+
+    // 注册自定义 codec (id 0~255，不能与已有的重复)，之后打包/解包都可以用。
+    // estimate 为 NULL 时 AUTO 模式不会自动选中它。只应在启动阶段、打包/解包开始之前调用
+    LIBRARY_API int C_RegisterCodec(int id, const char* name, CCodecFn encode, CCodecFn decode,
+                                    CEstimateFn estimate, void* ctx) {
+        try {
+            if (id < 0 || id > 255 || !encode || !decode) return 0;
+            Codec codec;
+            codec.id = static_cast<uint8_t>(id);
+            codec.name = name ? name : "";
+            codec.encode = wrapCodecFn(encode, ctx);
+            codec.decode = wrapCodecFn(decode, ctx);
+            if (estimate) {
+                codec.estimate = [estimate, ctx](const CodecSample&, const char* data, size_t size) {
+                    return estimate(ctx, data, size);
+                };
+            }
+            registerCodec(codec);
+            return 1;
+        } catch (const std::exception& e) {
+            std::cerr << "C++ Exception: " << e.what() << std::endl;
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,182 @@
+// src/Delta.cpp
+#include "Delta.h"
+#include <unordered_map>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+
+namespace {
+
+// 块大小取 sqrt(文件大小) 附近的 2 的幂，限制在 [1 KiB, 16 KiB]：
+// 小块让数据库这类按页改动的文件差量更精确，上限控制签名的内存
+uint32_t chooseBlockSize(size_t size) {
+    uint32_t block = 1024;
+    const double target = std::sqrt(static_cast<double>(size));
+    while (block < 16384 && block < target) block <<= 1;
+    return block;
+}
+
+// rsync 滚动校验: a = Σx, b = Σ(L - i)·x，各取低 16 位
+struct Rolling {
+    uint32_t a = 0;
+    uint32_t b = 0;
+
+    void init(const unsigned char* p, size_t len) {
+        a = 0;
+        b = 0;
+        for (size_t i = 0; i < len; ++i) {
+            a += p[i];
+            b += static_cast<uint32_t>(len - i) * p[i];
+        }
+    }
+    void roll(unsigned char out, unsigned char in, size_t len) {
+        a += in - out;
+        b += a - static_cast<uint32_t>(len) * out;
+    }
+    uint32_t digest() const { return (a & 0xFFFF) | (b << 16); }
+};
+
+void putU64(std::vector<char>& out, uint64_t v) {
+    auto p = reinterpret_cast<const char*>(&v);
+    out.insert(out.end(), p, p + 8);
+}
+
+uint64_t getU64(const char*& p, const char* end) {
+    if (end - p < 8) throw std::runtime_error("Corrupted delta: truncated");
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    p += 8;
+    return v;
+}
+
+// 指令流写出器: 相邻且基准偏移连续的拷贝合并成一条
+class DeltaWriter {
+    std::vector<char>& out;
+    size_t lastCopyPos = SIZE_MAX;
+    uint64_t lastCopyEnd = 0;
+
+public:
+    explicit DeltaWriter(std::vector<char>& out) : out(out) {}
+
+    void copy(uint64_t offset, uint64_t len) {
+        if (lastCopyPos != SIZE_MAX && lastCopyEnd == offset) {
+            uint64_t merged;
+            std::memcpy(&merged, out.data() + lastCopyPos + 9, 8);
+            merged += len;
+            std::memcpy(out.data() + lastCopyPos + 9, &merged, 8);
+        } else {
+            lastCopyPos = out.size();
+            out.push_back(static_cast<char>(DELTA_OP_COPY));
+            putU64(out, offset);
+            putU64(out, len);
+        }
+        lastCopyEnd = offset + len;
+    }
+
+    void literal(const char* data, uint64_t len) {
+        if (len == 0) return;
+        out.push_back(static_cast<char>(DELTA_OP_LITERAL));
+        putU64(out, len);
+        out.insert(out.end(), data, data + len);
+        lastCopyPos = SIZE_MAX;
+    }
+};
+
+} // namespace
+
+DeltaSignature DeltaSignature::build(const char* data, size_t size) {
+    DeltaSignature sig;
+    sig.blockSize = chooseBlockSize(size);
+    sig.fileSize = size;
+
+    const size_t blocks = size / sig.blockSize;
+    sig.weak.reserve(blocks);
+    sig.strong.reserve(blocks);
+    Rolling r;
+    for (size_t k = 0; k < blocks; ++k) {
+        const char* p = data + k * sig.blockSize;
+        r.init(reinterpret_cast<const unsigned char*>(p), sig.blockSize);
+        sig.weak.push_back(r.digest());
+        sig.strong.push_back(Hash128::calculate(p, sig.blockSize));
+    }
+    return sig;
+}
+
+bool computeDelta(const DeltaSignature& sig, const char* data, size_t size, std::vector<char>& out) {
+    out.clear();
+    putU64(out, size);
+    DeltaWriter writer(out);
+
+    const size_t L = sig.blockSize;
+    if (sig.weak.empty() || size < L) {
+        writer.literal(data, size);
+        return false;
+    }
+
+    std::unordered_multimap<uint32_t, uint32_t> index;
+    index.reserve(sig.weak.size());
+    for (uint32_t k = 0; k < sig.weak.size(); ++k) index.emplace(sig.weak[k], k);
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t pos = 0;
+    size_t literalStart = 0;
+    Rolling r;
+    r.init(bytes, L);
+
+    while (pos + L <= size) {
+        bool matched = false;
+        auto range = index.equal_range(r.digest());
+        if (range.first != range.second) {
+            Hash128Value strong = Hash128::calculate(data + pos, L);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (sig.strong[it->second] == strong) {
+                    writer.literal(data + literalStart, pos - literalStart);
+                    writer.copy(static_cast<uint64_t>(it->second) * L, L);
+                    matched = true;
+                    break;
+                }
+            }
+        }
+
+        if (matched) {
+            pos += L;
+            literalStart = pos;
+            if (pos + L <= size) r.init(bytes + pos, L);
+            continue;
+        }
+
+        if (pos + L < size) r.roll(bytes[pos], bytes[pos + L], L);
+        pos++;
+    }
+    writer.literal(data + literalStart, size - literalStart);
+
+    // 差量超过原文件 90% 就没必要让解包去找基准了
+    return out.size() < size - size / 10;
+}
+
+void applyDelta(const char* base, size_t baseSize, const char* delta, size_t deltaSize, std::vector<char>& out) {
+    const char* p = delta;
+    const char* end = delta + deltaSize;
+
+    const uint64_t targetSize = getU64(p, end);
+    out.clear();
+    out.reserve(targetSize);
+
+    while (p < end) {
+        const auto op = static_cast<uint8_t>(*p++);
+        if (op == DELTA_OP_COPY) {
+            uint64_t offset = getU64(p, end);
+            uint64_t len = getU64(p, end);
+            if (offset > baseSize || len > baseSize - offset) throw std::runtime_error("Corrupted delta: copy out of range");
+            out.insert(out.end(), base + offset, base + offset + len);
+        } else if (op == DELTA_OP_LITERAL) {
+            uint64_t len = getU64(p, end);
+            if (len > static_cast<uint64_t>(end - p)) throw std::runtime_error("Corrupted delta: literal out of range");
+            out.insert(out.end(), p, p + len);
+            p += len;
+        } else {
+            throw std::runtime_error("Corrupted delta: unknown op");
+        }
+    }
+    if (out.size() != targetSize) throw std::runtime_error("Corrupted delta: size mismatch");
+}
@@ -0,0 +1,102 @@
+// src/FileList.cpp
+#include "FileList.h"
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+namespace {
+constexpr char kSeparator = static_cast<char>(std::filesystem::path::preferred_separator);
+}
+
+FileList::FileList(std::string rootPath) : rootPath(std::move(rootPath)) {}
+
+uint32_t FileList::appendName(const std::string& name) {
+    if (nameArena.size() + name.size() > UINT32_MAX) throw std::runtime_error("Too many file names to scan");
+    const auto off = static_cast<uint32_t>(nameArena.size());
+    nameArena.insert(nameArena.end(), name.begin(), name.end());
+    return off;
+}
+
+uint32_t FileList::internOwner(const FileRecord& rec) {
+    const Owner owner{rec.mode, rec.uid, rec.gid};
+    if (lastOwner != UINT32_MAX && owners[lastOwner] == owner) return lastOwner;
+
+    auto it = ownerIndex.find(owner);
+    if (it == ownerIndex.end()) {
+        it = ownerIndex.emplace(owner, static_cast<uint32_t>(owners.size())).first;
+        owners.push_back(owner);
+    }
+    lastOwner = it->second;
+    return lastOwner;
+}
+
+uint32_t FileList::addNode(uint32_t parent, const std::string& name) {
+    if (name.size() > UINT16_MAX) throw std::runtime_error("File name too long: " + name);
+    if (nodeParent.size() >= NO_PARENT) throw std::runtime_error("Too many files to scan");
+
+    nodeNameOff.push_back(appendName(name));
+    nodeNameLen.push_back(static_cast<uint16_t>(name.size()));
+    nodeParent.push_back(parent);
+    return static_cast<uint32_t>(nodeParent.size() - 1);
+}
+
+void FileList::add(uint32_t node, const FileRecord& rec) {
+    if (rec.type == FileType::SYMLINK && !rec.linkTarget.empty()) {
+        linkOff.push_back(appendName(rec.linkTarget));
+        linkRecords.push_back(static_cast<uint32_t>(types.size()));
+        linkLen.push_back(static_cast<uint32_t>(rec.linkTarget.size()));
+    }
+
+    nodes.push_back(node);
+    types.push_back(static_cast<uint8_t>(rec.type));
+    sizes.push_back(rec.size);
+    mtimes.push_back(rec.mtime);
+    ownerIds.push_back(internOwner(rec));
+}
+
+void FileList::appendRelPath(uint32_t node, std::string& out) const {
+    // 先拼父节点，深度受限于系统路径长度，递归即可
+    uint32_t parent = nodeParent[node];
+    if (parent != NO_PARENT) {
+        appendRelPath(parent, out);
+        out.push_back(kSeparator);
+    }
+    out.append(nameArena.data() + nodeNameOff[node], nodeNameLen[node]);
+}
+
+std::string FileList::relPath(size_t index) const {
+    std::string out;
+    appendRelPath(nodes[index], out);
+    return out;
+}
+
+std::string FileList::absPath(size_t index) const {
+    std::string out = rootPath;
+    if (!out.empty() && out.back() != kSeparator) out.push_back(kSeparator);
+    appendRelPath(nodes[index], out);
+    return out;
+}
+
+void FileList::fill(size_t index, FileRecord& out) const {
+    out.relPath.clear();
+    appendRelPath(nodes[index], out.relPath);
+
+    out.absPath = rootPath;
+    if (!out.absPath.empty() && out.absPath.back() != kSeparator) out.absPath.push_back(kSeparator);
+    out.absPath += out.relPath;
+
+    out.type = static_cast<FileType>(types[index]);
+    out.size = sizes[index];
+    out.mtime = mtimes[index];
+    const Owner& owner = owners[ownerIds[index]];
+    out.mode = owner[0];
+    out.uid = owner[1];
+    out.gid = owner[2];
+
+    out.linkTarget.clear();
+    auto it = std::lower_bound(linkRecords.begin(), linkRecords.end(), static_cast<uint32_t>(index));
+    if (it != linkRecords.end() && *it == index) {
+        size_t k = static_cast<size_t>(it - linkRecords.begin());
+        out.linkTarget.assign(nameArena.data() + linkOff[k], linkLen[k]);
+    }
+}
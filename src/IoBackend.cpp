@@ -0,0 +1,390 @@
+// src/IoBackend.cpp
+#include "IoBackend.h"
+#include "RestoreWriter.h"
+#include "ThreadPool.h"
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+    #define MINIBACKUP_HAS_URING 1
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+#endif
+
+// 单次 read 的上限，超出部分 (以及被信号打断的短读) 由同步 pread 补齐
+constexpr size_t URING_READ_MAX = 1u << 30;
+
+namespace {
+
+#ifndef _WIN32
+// 同步读完 fd 剩余部分，返回 errno
+int readRest(int fd, std::vector<char>& data, size_t have) {
+    while (have < data.size()) {
+        ssize_t n = ::pread(fd, data.data() + have, data.size() - have, static_cast<off_t>(have));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno;
+        if (n == 0) break; // 文件在扫描后变短，按实际内容截断
+        have += static_cast<size_t>(n);
+    }
+    data.resize(have);
+    return 0;
+}
+
+int writeRest(int fd, const char* data, size_t size, size_t done) {
+    while (done < size) {
+        ssize_t n = ::pwrite(fd, data + done, size - done, static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n < 0 ? errno : EIO;
+        done += static_cast<size_t>(n);
+    }
+    return 0;
+}
+#endif
+
+void readOne(ReadJob& job) {
+#ifdef _WIN32
+    std::ifstream in(fs::u8path(job.path), std::ios::binary);
+    if (!in) {
+        job.error = ENOENT;
+        return;
+    }
+    job.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+#else
+    int fd = ::open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        job.error = errno;
+        return;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        job.error = errno;
+    } else {
+        job.data.resize(static_cast<size_t>(st.st_size));
+        job.error = readRest(fd, job.data, 0);
+    }
+    ::close(fd);
+#endif
+}
+
+#ifndef _WIN32
+void writeOne(WriteJob& job) {
+    int fd = ::openat(job.dirFd, job.name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        job.error = errno;
+        return;
+    }
+    job.error = writeRest(fd, job.data, job.size, 0);
+    if (job.error == 0 && job.meta) RestoreWriter::applyFdMeta(fd, *job.meta);
+    ::close(fd);
+}
+#endif
+
+// ==========================================
+// 线程池后端
+// ==========================================
+class ThreadIo : public IoBackend {
+    std::unique_ptr<ThreadPool> ownPool;
+    ThreadPool& pool;
+
+    // 按线程数切片，每片一个任务，避免每个小文件一次任务调度
+    template <typename Job, typename Fn>
+    void run(std::vector<Job>& jobs, Fn fn) {
+        const size_t slices = std::min<size_t>(pool.size(), jobs.size());
+        if (slices <= 1) {
+            for (auto& job : jobs) fn(job);
+            return;
+        }
+        std::vector<std::future<void>> futures;
+        futures.reserve(slices);
+        for (size_t s = 0; s < slices; ++s) {
+            futures.push_back(pool.submit([&jobs, &fn, s, slices] {
+                for (size_t k = s; k < jobs.size(); k += slices) fn(jobs[k]);
+            }));
+        }
+        for (auto& f : futures) f.get();
+    }
+
+public:
+    ThreadIo(unsigned threads, ThreadPool* shared)
+        : ownPool(shared ? nullptr : std::make_unique<ThreadPool>(threads)), pool(shared ? *shared : *ownPool) {}
+
+    const char* name() const override { return "threads"; }
+
+    void readFiles(std::vector<ReadJob>& jobs) override { run(jobs, readOne); }
+#ifndef _WIN32
+    void writeFiles(std::vector<WriteJob>& jobs) override { run(jobs, writeOne); }
+#endif
+};
+
+#ifdef MINIBACKUP_HAS_URING
+// ==========================================
+// io_uring 后端 (直接走系统调用，不依赖 liburing)
+// ==========================================
+class UringIo : public IoBackend {
+    int ringFd = -1;
+    unsigned entries = 0;
+
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned queued = 0; // 本批已填好、尚未提交的 SQE 数
+
+    static int enter(int fd, unsigned submit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, minComplete, flags, nullptr, 0));
+    }
+
+    bool supportsOps() {
+        const size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        std::vector<char> buf(probeSize, 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        for (int op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    io_uring_sqe* nextSqe(uint64_t userData) {
+        const unsigned tail = *sqTail + queued;
+        const unsigned index = tail & *sqMask;
+        sqArray[index] = index;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        queued++;
+        return sqe;
+    }
+
+    // 提交已填好的 SQE 并等全部完成，onComplete(userData, res) 逐个回调
+    template <typename Fn>
+    void submitAndWait(Fn onComplete) {
+        const unsigned total = queued;
+        __atomic_store_n(sqTail, *sqTail + queued, __ATOMIC_RELEASE);
+        queued = 0;
+
+        unsigned toSubmit = total;
+        unsigned done = 0;
+        while (done < total) {
+            int ret = enter(ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+            toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(ret));
+
+            unsigned head = *cqHead;
+            const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head, ++done) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                onComplete(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    void closeAll(const std::vector<int>& fds) {
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] < 0) continue;
+            io_uring_sqe* sqe = nextSqe(k);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fds[k];
+        }
+        submitAndWait([](uint64_t, int) {});
+    }
+
+    void readChunk(ReadJob* jobs, size_t count) {
+        std::vector<struct statx> stx(count);
+        std::vector<int> fds(count, -1);
+
+        // 阶段 1: statx + openat (每个文件 2 个 SQE)
+        for (size_t k = 0; k < count; ++k) {
+            io_uring_sqe* sqe = nextSqe(k * 2);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(jobs[k].path.c_str());
+            sqe->len = STATX_SIZE;
+            sqe->off = reinterpret_cast<uint64_t>(&stx[k]);
+
+            sqe = nextSqe(k * 2 + 1);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(jobs[k].path.c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+        submitAndWait([&](uint64_t tag, int res) {
+            ReadJob& job = jobs[tag / 2];
+            if (res < 0) job.error = -res;
+            else if (tag % 2 == 1) fds[tag / 2] = res;
+        });
+
+        // 阶段 2: 按 statx 的大小整文件 read
+        std::vector<size_t> got(count, 0);
+        for (size_t k = 0; k < count; ++k) {
+            if (fds[k] < 0 || jobs[k].error != 0) continue;
+            jobs[k].data.resize(static_cast<size_t>(stx[k].stx_size));
+            if (jobs[k].data.empty()) continue;
+            io_uring_sqe* sqe = nextSqe(k);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fds[k];
+            sqe->addr = reinterpret_cast<uint64_t>(jobs[k].data.data());
+            sqe->len = static_cast<uint32_t>(std::min(jobs[k].data.size(), URING_READ_MAX));
+            sqe->off = 0;
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            if (res < 0) jobs[k].error = -res;
+            else got[k] = static_cast<size_t>(res);
+        });
+        for (size_t k = 0; k < count; ++k) {
+            if (fds[k] >= 0 && jobs[k].error == 0) jobs[k].error = readRest(fds[k], jobs[k].data, got[k]);
+        }
+
+        // 阶段 3: close
+        closeAll(fds);
+    }
+
+    void writeChunk(WriteJob* jobs, size_t count) {
+        std::vector<int> fds(count, -1);
+
+        // 阶段 1: openat
+        for (size_t k = 0; k < count; ++k) {
+            io_uring_sqe* sqe = nextSqe(k);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = jobs[k].dirFd;
+            sqe->addr = reinterpret_cast<uint64_t>(jobs[k].name.c_str());
+            sqe->len = 0600;
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            if (res < 0) jobs[k].error = -res;
+            else fds[k] = res;
+        });
+
+        // 阶段 2: write
+        std::vector<size_t> put(count, 0);
+        for (size_t k = 0; k < count; ++k) {
+            if (fds[k] < 0 || jobs[k].size == 0) continue;
+            io_uring_sqe* sqe = nextSqe(k);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fds[k];
+            sqe->addr = reinterpret_cast<uint64_t>(jobs[k].data);
+            sqe->len = static_cast<uint32_t>(std::min(jobs[k].size, URING_READ_MAX));
+            sqe->off = 0;
+        }
+        submitAndWait([&](uint64_t k, int res) {
+            if (res < 0) jobs[k].error = -res;
+            else put[k] = static_cast<size_t>(res);
+        });
+
+        // io_uring 没有 chmod/chown/utimes 操作码，元数据仍在已打开的 fd 上同步回写
+        for (size_t k = 0; k < count; ++k) {
+            if (fds[k] < 0 || jobs[k].error != 0) continue;
+            jobs[k].error = writeRest(fds[k], jobs[k].data, jobs[k].size, put[k]);
+            if (jobs[k].error == 0 && jobs[k].meta) RestoreWriter::applyFdMeta(fds[k], *jobs[k].meta);
+        }
+
+        // 阶段 3: close
+        closeAll(fds);
+    }
+
+public:
+    bool init(unsigned ringEntries) {
+        io_uring_params params{};
+        ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, ringEntries, &params));
+        if (ringFd < 0) return false;
+        entries = params.sq_entries;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) { sqRing = nullptr; return false; }
+        if (singleMmap) {
+            cqRing = sqRing;
+        } else {
+            cqRing = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) { cqRing = nullptr; return false; }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqeMem = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ringFd, IORING_OFF_SQES);
+        if (sqeMem == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(sqeMem);
+
+        auto* sq = static_cast<char*>(sqRing);
+        auto* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return supportsOps();
+    }
+
+    ~UringIo() override {
+        if (sqes) ::munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+        if (sqRing) ::munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) ::close(ringFd);
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    // 读阶段 1 每个文件占 2 个 SQE，所以一轮最多 entries / 2 个文件
+    void readFiles(std::vector<ReadJob>& jobs) override {
+        const size_t step = entries / 2;
+        for (size_t k = 0; k < jobs.size(); k += step) {
+            readChunk(jobs.data() + k, std::min(step, jobs.size() - k));
+        }
+    }
+
+    void writeFiles(std::vector<WriteJob>& jobs) override {
+        for (size_t k = 0; k < jobs.size(); k += entries) {
+            writeChunk(jobs.data() + k, std::min<size_t>(entries, jobs.size() - k));
+        }
+    }
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<IoBackend> IoBackend::create(IoBackendKind kind, unsigned threads, ThreadPool* pool) {
+    if (kind == IoBackendKind::SYNC) return nullptr;
+#ifdef MINIBACKUP_HAS_URING
+    if (kind == IoBackendKind::AUTO || kind == IoBackendKind::URING) {
+        // 内核太旧、被 sysctl/seccomp 禁用时 init 失败，退回线程池
+        auto uring = std::make_unique<UringIo>();
+        if (uring->init(256)) return uring;
+    }
+#endif
+    return std::make_unique<ThreadIo>(threads, pool);
+}
@@ -0,0 +1,109 @@
+// src/Pipeline.cpp
+#include "Pipeline.h"
+#include <array>
+#include <cmath>
+
+namespace {
+
+// RLE: 每个游程输出 (count, value) 两字节，count 最大 255
+void rleEncode(const char* data, size_t size, std::vector<char>& out) {
+    out.reserve(size / 2 + 2);
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char count = 1;
+        while (i + 1 < size && data[i] == data[i + 1] && count < 255) {
+            count++;
+            i++;
+        }
+        out.push_back(static_cast<char>(count));
+        out.push_back(data[i]);
+    }
+}
+
+// 奇数长度 (截断抢救时可能出现) 时丢弃最后半个游程
+void rleDecode(const char* data, size_t size, std::vector<char>& out) {
+    size_t total = 0;
+    for (size_t i = 0; i + 1 < size; i += 2) total += static_cast<unsigned char>(data[i]);
+    out.resize(total);
+    char* dst = out.data();
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        const auto count = static_cast<unsigned char>(data[i]);
+        std::fill(dst, dst + count, data[i + 1]);
+        dst += count;
+    }
+}
+
+// RLE 每个游程输出 2 字节，平均游程不到 2 就只会变大
+double rleEstimate(const CodecSample& sample, const char*, size_t) {
+    return sample.bytes == 0 ? 1.0 : 2.0 * static_cast<double>(sample.runs) / static_cast<double>(sample.bytes);
+}
+
+struct CodecTable {
+    std::array<Codec, 256> codecs{};
+    std::array<bool, 256> present{};
+    std::vector<const Codec*> ordered;
+
+    CodecTable() {
+        add({PCK_CODEC_STORE, "store", nullptr, nullptr, nullptr});
+        add({PCK_CODEC_RLE, "rle", rleEncode, rleDecode, rleEstimate});
+    }
+    void add(const Codec& codec) {
+        if (present[codec.id]) throw std::runtime_error("Codec ID already registered: " + std::to_string(codec.id));
+        codecs[codec.id] = codec;
+        present[codec.id] = true;
+        ordered.clear();
+        for (size_t id = 0; id < codecs.size(); ++id) {
+            if (present[id]) ordered.push_back(&codecs[id]);
+        }
+    }
+};
+
+CodecTable& codecTable() {
+    static CodecTable table;
+    return table;
+}
+
+} // namespace
+
+CodecSample sampleData(const char* data, size_t size) {
+    constexpr size_t kWindow = 4096;
+    CodecSample sample;
+    uint32_t hist[256] = {0};
+
+    auto scan = [&](size_t start, size_t len) {
+        const auto* p = reinterpret_cast<const unsigned char*>(data + start);
+        for (size_t i = 0; i < len; ++i) {
+            hist[p[i]]++;
+            if (i == 0 || p[i] != p[i - 1]) sample.runs++;
+        }
+        sample.bytes += len;
+    };
+    if (size <= 3 * kWindow) {
+        scan(0, size);
+    } else {
+        scan(0, kWindow);
+        scan(size / 2 - kWindow / 2, kWindow);
+        scan(size - kWindow, kWindow);
+    }
+
+    double entropy = 0;
+    for (uint32_t count : hist) {
+        if (count == 0) continue;
+        const double p = static_cast<double>(count) / static_cast<double>(sample.bytes);
+        entropy -= p * std::log2(p);
+    }
+    sample.entropy = entropy;
+    return sample;
+}
+
+const Codec* findCodec(uint8_t id) {
+    const CodecTable& table = codecTable();
+    return table.present[id] ? &table.codecs[id] : nullptr;
+}
+
+const std::vector<const Codec*>& registeredCodecs() {
+    return codecTable().ordered;
+}
+
+void registerCodec(const Codec& codec) {
+    codecTable().add(codec);
+}
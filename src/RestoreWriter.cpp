@@ -0,0 +1,377 @@
+// src/RestoreWriter.cpp
+#include "RestoreWriter.h"
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef _WIN32
+    #include <sys/utime.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+    #include <sys/types.h>
+#endif
+
+// 目录 fd 缓存上限，超过后整体清空，防止超深/超宽目录树耗尽 fd
+constexpr size_t MAX_CACHED_DIRS = 1024;
+
+// O_DIRECT 要求缓冲区、偏移和长度都按块对齐
+constexpr size_t DIRECT_IO_ALIGN = 4096;
+constexpr size_t DIRECT_IO_CHUNK = 4 << 20;
+
+// 不超过此大小的文件进入批量写；攒够条数或字节数就下发一批
+constexpr size_t BATCH_FILE_MAX = 64 << 10;
+constexpr size_t BATCH_FILES = 1024;
+constexpr size_t BATCH_BYTES = 16 << 20;
+
+namespace {
+
+// "a/b/c.txt" -> {"a/b", "c.txt"}
+std::pair<std::string, std::string> splitRelPath(const std::string& relPath) {
+    size_t pos = relPath.find_last_of("/\\");
+    if (pos == std::string::npos) return {"", relPath};
+    return {relPath.substr(0, pos), relPath.substr(pos + 1)};
+}
+
+#ifndef _WIN32
+void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Write failed: ") + std::strerror(errno));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+void toTimespec(int64_t mtime, struct timespec (&ts)[2]) {
+    ts[0].tv_sec = mtime; ts[0].tv_nsec = 0;
+    ts[1].tv_sec = mtime; ts[1].tv_nsec = 0;
+}
+#endif
+
+} // namespace
+
+#ifdef _WIN32
+
+// ==========================================
+// Windows: 沿用基于路径的写法
+// ==========================================
+RestoreWriter::RestoreWriter(const fs::path& root, uint64_t directIoMinSize, IoBackendKind ioBackend,
+                             unsigned threads, ThreadPool* pool)
+    : root(root), directIoMinSize(directIoMinSize) {
+    (void)ioBackend;
+    (void)threads;
+    (void)pool;
+    if (!fs::exists(root)) fs::create_directories(root);
+}
+
+RestoreWriter::~RestoreWriter() = default;
+
+static void applyPathMeta(const fs::path& fullPath, const EntryMeta& meta) {
+    struct __utimbuf64 new_times{};
+    new_times.actime = meta.mtime;
+    new_times.modtime = meta.mtime;
+    _wutime64(fullPath.c_str(), &new_times);
+}
+
+void RestoreWriter::writeFile(const std::string& relPath, const char* data, size_t size, const EntryMeta& meta) {
+    fs::path fullPath = root / fs::u8path(relPath);
+    if (fullPath.has_parent_path()) fs::create_directories(fullPath.parent_path());
+    {
+        std::ofstream outFile(fullPath, std::ios::binary);
+        outFile.write(data, static_cast<std::streamsize>(size));
+    }
+    applyPathMeta(fullPath, meta);
+}
+
+void RestoreWriter::makeDirectory(const std::string& relPath, const EntryMeta& meta) {
+    fs::create_directories(root / fs::u8path(relPath));
+    pendingDirs.push_back({relPath, meta});
+}
+
+void RestoreWriter::makeSymlink(const std::string& relPath, const std::string& target, const EntryMeta& meta) {
+    fs::path fullPath = root / fs::u8path(relPath);
+    if (fullPath.has_parent_path()) fs::create_directories(fullPath.parent_path());
+    if (fs::exists(fullPath) || fs::is_symlink(fullPath)) fs::remove(fullPath);
+    try { fs::create_symlink(target, fullPath); } catch (...) {}
+    (void)meta;
+}
+
+void RestoreWriter::copyFile(const std::string& srcRelPath, const std::string& relPath, const EntryMeta& meta) {
+    fs::path fullPath = root / fs::u8path(relPath);
+    if (fullPath.has_parent_path()) fs::create_directories(fullPath.parent_path());
+    fs::copy_file(root / fs::u8path(srcRelPath), fullPath, fs::copy_options::overwrite_existing);
+    applyPathMeta(fullPath, meta);
+}
+
+void RestoreWriter::finish() {
+    for (auto it = pendingDirs.rbegin(); it != pendingDirs.rend(); ++it) {
+        applyPathMeta(root / fs::u8path(it->relPath), it->meta);
+    }
+    pendingDirs.clear();
+}
+
+#else
+
+// ==========================================
+// POSIX: openat + 目录 fd 缓存
+// ==========================================
+RestoreWriter::RestoreWriter(const fs::path& root, uint64_t directIoMinSize, IoBackendKind ioBackend,
+                             unsigned threads, ThreadPool* pool)
+    : root(root), directIoMinSize(directIoMinSize), io(IoBackend::create(ioBackend, threads, pool)) {
+    if (!fs::exists(root)) fs::create_directories(root);
+    rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) throw std::runtime_error("Cannot open destination directory");
+}
+
+RestoreWriter::~RestoreWriter() {
+    // 异常退出 (包截断/损坏) 时，批里的文件都已通过校验，照常写出，与逐个写的结果一致；
+    // 析构里不能再抛，写失败只能忽略
+    try { flushWrites(); } catch (...) {}
+    writeBatch.clear();
+    closeDirs();
+    if (rootFd >= 0) ::close(rootFd);
+}
+
+void RestoreWriter::closeDirs() {
+    flushWrites();
+    for (auto& kv : dirFds) ::close(kv.second);
+    dirFds.clear();
+}
+
+void RestoreWriter::flushWrites() {
+    if (writeBatch.empty()) return;
+    for (size_t k = 0; k < writeBatch.size(); ++k) writeBatch[k].meta = &batchMeta[k];
+    io->writeFiles(writeBatch);
+
+    std::string failed;
+    for (size_t k = 0; k < writeBatch.size() && failed.empty(); ++k) {
+        if (writeBatch[k].error != 0) failed = batchPaths[k] + " (" + std::strerror(writeBatch[k].error) + ")";
+    }
+    writeBatch.clear();
+    batchPaths.clear();
+    batchData.clear();
+    batchMeta.clear();
+    batchBytes = 0;
+    if (!failed.empty()) throw std::runtime_error("Cannot create file: " + failed);
+}
+
+int RestoreWriter::openDir(const std::string& relDir) {
+    if (relDir.empty()) return rootFd;
+
+    auto it = dirFds.find(relDir);
+    if (it != dirFds.end()) return it->second;
+
+    // 先淘汰再递归，保证返回给上层的父目录 fd 在本次调用内有效
+    if (dirFds.size() >= MAX_CACHED_DIRS) closeDirs();
+
+    auto [parent, name] = splitRelPath(relDir);
+    if (name.empty() || name == "." || name == "..") {
+        throw std::runtime_error("Unsafe path in pack: " + relDir);
+    }
+    int parentFd = openDir(parent);
+
+    if (::mkdirat(parentFd, name.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create directory: " + relDir);
+    }
+    int fd = ::openat(parentFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Cannot open directory: " + relDir);
+
+    dirFds.emplace(relDir, fd);
+    return fd;
+}
+
+void RestoreWriter::writeDirect(int fd, const char* data, size_t size) {
+    size_t alignedSize = size & ~(DIRECT_IO_ALIGN - 1);
+
+    void* raw = nullptr;
+    if (posix_memalign(&raw, DIRECT_IO_ALIGN, DIRECT_IO_CHUNK) != 0) {
+        throw std::runtime_error("Cannot allocate direct I/O buffer");
+    }
+    auto* buffer = static_cast<char*>(raw);
+    try {
+        for (size_t off = 0; off < alignedSize; off += DIRECT_IO_CHUNK) {
+            size_t step = std::min(DIRECT_IO_CHUNK, alignedSize - off);
+            std::memcpy(buffer, data + off, step);
+            writeAll(fd, buffer, step);
+        }
+    } catch (...) {
+        std::free(raw);
+        throw;
+    }
+    std::free(raw);
+
+    // 尾部不足一个块，关掉 O_DIRECT 后普通写入
+    if (alignedSize < size) {
+        int flags = ::fcntl(fd, F_GETFL);
+        ::fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+        writeAll(fd, data + alignedSize, size - alignedSize);
+    }
+}
+
+int RestoreWriter::createFile(const std::string& relPath, size_t size, bool& direct) {
+    auto [dir, name] = splitRelPath(relPath);
+    int dirFd = openDir(dir);
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    direct = false;
+    int fd = -1;
+#ifdef O_DIRECT
+    if (directIoMinSize > 0 && size >= directIoMinSize) {
+        fd = ::openat(dirFd, name.c_str(), flags | O_DIRECT, 0600);
+        direct = (fd >= 0); // tmpfs 等不支持 O_DIRECT 时退回普通写
+    }
+#endif
+    if (fd < 0) fd = ::openat(dirFd, name.c_str(), flags, 0600);
+    if (fd < 0) throw std::runtime_error("Cannot create file: " + relPath);
+
+#ifdef __linux__
+    // 预分配失败 (如文件系统不支持) 不影响写入
+    if (size > 0) ::fallocate(fd, 0, 0, static_cast<off_t>(size));
+#endif
+    return fd;
+}
+
+void RestoreWriter::applyFdMeta(int fd, const EntryMeta& meta) {
+    struct timespec ts[2];
+    toTimespec(meta.mtime, ts);
+    ::fchmod(fd, meta.mode);
+    if (::fchown(fd, meta.uid, meta.gid) != 0) { /* 非 root 无权 chown，忽略 */ }
+    ::futimens(fd, ts);
+}
+
+void RestoreWriter::writeFile(const std::string& relPath, const char* data, size_t size, const EntryMeta& meta) {
+    const bool wantDirect = directIoMinSize > 0 && size >= directIoMinSize;
+    if (io && size <= BATCH_FILE_MAX && !wantDirect) {
+        // data 属于调用方的临时缓冲区，入批前拷一份；meta 指针在下发前补齐 (batchMeta 可能扩容)
+        auto [dir, name] = splitRelPath(relPath);
+        WriteJob job;
+        job.dirFd = openDir(dir);
+        job.name = name;
+        batchData.emplace_back(data, data + size);
+        job.data = batchData.back().data();
+        job.size = size;
+        batchMeta.push_back(meta);
+        writeBatch.push_back(std::move(job));
+        batchPaths.push_back(relPath);
+        batchBytes += size;
+        if (writeBatch.size() >= BATCH_FILES || batchBytes >= BATCH_BYTES) flushWrites();
+        return;
+    }
+
+    bool direct = false;
+    int fd = createFile(relPath, size, direct);
+
+    try {
+#ifdef O_DIRECT
+        if (direct) writeDirect(fd, data, size);
+        else writeAll(fd, data, size);
+#else
+        writeAll(fd, data, size);
+#endif
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    applyFdMeta(fd, meta);
+    ::close(fd);
+}
+
+void RestoreWriter::copyFile(const std::string& srcRelPath, const std::string& relPath, const EntryMeta& meta) {
+    flushWrites(); // 去重源文件可能还在批次里
+    auto [srcDir, srcName] = splitRelPath(srcRelPath);
+    int srcFd = ::openat(openDir(srcDir), srcName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (srcFd < 0) throw std::runtime_error("Cannot open dedup source: " + srcRelPath);
+
+    struct stat st{};
+    ::fstat(srcFd, &st);
+    size_t remaining = static_cast<size_t>(st.st_size);
+
+    bool direct = false;
+    int fd = -1;
+    try {
+        fd = createFile(relPath, remaining, direct);
+#ifdef O_DIRECT
+        if (direct) {
+            int flags = ::fcntl(fd, F_GETFL);
+            ::fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+        }
+#endif
+#ifdef __linux__
+        // 内核内拷贝，支持的文件系统上还能直接共享数据块
+        while (remaining > 0) {
+            ssize_t n = ::copy_file_range(srcFd, nullptr, fd, nullptr, remaining, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            remaining -= static_cast<size_t>(n);
+        }
+#endif
+        // 不支持 copy_file_range 时退回用户态拷贝
+        std::vector<char> buffer;
+        while (remaining > 0) {
+            if (buffer.empty()) buffer.resize(1 << 20);
+            ssize_t n = ::read(srcFd, buffer.data(), std::min(buffer.size(), remaining));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            writeAll(fd, buffer.data(), static_cast<size_t>(n));
+            remaining -= static_cast<size_t>(n);
+        }
+    } catch (...) {
+        if (fd >= 0) ::close(fd);
+        ::close(srcFd);
+        throw;
+    }
+    ::close(srcFd);
+    if (remaining > 0) {
+        ::close(fd);
+        throw std::runtime_error("Copy dedup source failed: " + srcRelPath);
+    }
+
+    applyFdMeta(fd, meta);
+    ::close(fd);
+}
+
+void RestoreWriter::makeDirectory(const std::string& relPath, const EntryMeta& meta) {
+    openDir(relPath);
+    pendingDirs.push_back({relPath, meta});
+}
+
+void RestoreWriter::makeSymlink(const std::string& relPath, const std::string& target, const EntryMeta& meta) {
+    auto [dir, name] = splitRelPath(relPath);
+    int dirFd = openDir(dir);
+
+    ::unlinkat(dirFd, name.c_str(), 0);
+    if (::symlinkat(target.c_str(), dirFd, name.c_str()) != 0) return;
+
+    struct timespec ts[2];
+    toTimespec(meta.mtime, ts);
+    if (::fchownat(dirFd, name.c_str(), meta.uid, meta.gid, AT_SYMLINK_NOFOLLOW) != 0) { /* 忽略 */ }
+    ::utimensat(dirFd, name.c_str(), ts, AT_SYMLINK_NOFOLLOW);
+}
+
+void RestoreWriter::finish() {
+    // 批次里的文件创建会改动所在目录的 mtime，先全部写完
+    flushWrites();
+
+    // 逆序回写：子目录先于父目录，父目录的 mtime 不会再被改动
+    for (auto it = pendingDirs.rbegin(); it != pendingDirs.rend(); ++it) {
+        const char* path = it->relPath.c_str();
+        struct timespec ts[2];
+        toTimespec(it->meta.mtime, ts);
+        ::fchmodat(rootFd, path, it->meta.mode, 0);
+        if (::fchownat(rootFd, path, it->meta.uid, it->meta.gid, 0) != 0) { /* 忽略 */ }
+        ::utimensat(rootFd, path, ts, 0);
+    }
+    pendingDirs.clear();
+    closeDirs();
+}
+
+#endif
@@ -0,0 +1,330 @@
+// src/VolumeSet.cpp
+#include "VolumeSet.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 解包时每个目录的预读线程最多积压这么多块 (写方向的队列深度见 VolumeOutBuf)
+constexpr size_t VOLUME_READ_AHEAD_CHUNKS = 8;
+
+struct Chunk {
+    unsigned volume = 0;      // 写方向: 所属卷号
+    std::vector<char> data;
+    bool endOfVolume = false; // 本卷最后一块
+    std::string error;        // 读方向: 非空表示预读失败
+};
+
+// 有界队列: 满时 push 阻塞，close 后 push 失败、pop 取完剩余的块再返回 false
+class ChunkQueue {
+    std::deque<Chunk> items;
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t capacity;
+    bool closed = false;
+
+public:
+    explicit ChunkQueue(size_t capacity = VOLUME_READ_AHEAD_CHUNKS) : capacity(capacity) {}
+
+    bool push(Chunk&& chunk) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(chunk));
+        cv.notify_all();
+        return true;
+    }
+
+    bool pop(Chunk& chunk) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        chunk = std::move(items.front());
+        items.pop_front();
+        cv.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        cv.notify_all();
+    }
+};
+
+fs::path parentOrCwd(const fs::path& p) {
+    return p.has_parent_path() ? p.parent_path() : fs::path(".");
+}
+
+} // namespace
+
+std::string volumeFileName(const std::string& baseName, unsigned index) {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".%03u", index);
+    return baseName + suffix;
+}
+
+// ==========================================
+// 写分卷
+// ==========================================
+
+// 每个目录一个写线程，按到达顺序写自己负责的卷
+struct VolumeOutBuf::Writer {
+    fs::path dir;
+    std::string baseName;
+    ChunkQueue queue;
+    std::string error;
+    std::thread thread;
+
+    Writer(fs::path dir, std::string baseName, size_t queueChunks)
+        : dir(std::move(dir)), baseName(std::move(baseName)), queue(queueChunks) {
+        thread = std::thread([this] { run(); });
+    }
+    ~Writer() {
+        queue.close();
+        if (thread.joinable()) thread.join();
+    }
+
+    void run() {
+        std::ofstream out;
+        unsigned openVolume = 0;
+        fs::path path;
+        Chunk chunk;
+        while (queue.pop(chunk)) {
+            // 出错后继续取空队列，不让打包线程卡在 push 上
+            if (!error.empty()) continue;
+            if (chunk.volume != openVolume) {
+                out.close();
+                path = dir / fs::u8path(volumeFileName(baseName, chunk.volume));
+                out.open(path, std::ios::binary | std::ios::trunc);
+                openVolume = chunk.volume;
+                if (!out.is_open()) {
+                    error = "Cannot create volume: " + path.u8string();
+                    continue;
+                }
+            }
+            out.write(chunk.data.data(), static_cast<std::streamsize>(chunk.data.size()));
+            if (chunk.endOfVolume) {
+                out.close();
+                openVolume = 0;
+            }
+            if (!out) error = "Write volume failed: " + path.u8string();
+        }
+        out.close();
+        if (!out && error.empty() && openVolume != 0) error = "Write volume failed: " + path.u8string();
+    }
+};
+
+VolumeOutBuf::VolumeOutBuf(const std::string& archivePath, uint64_t volumeSize,
+                           const std::vector<std::string>& dirs, size_t chunkSize, uint64_t queueBytes)
+    : volumeSize(volumeSize), chunkSize(chunkSize), buffer(chunkSize) {
+    if (volumeSize == 0) throw std::runtime_error("Volume size must be positive");
+    const fs::path archive = fs::u8path(archivePath);
+    baseName = archive.filename().u8string();
+    if (baseName.empty()) throw std::runtime_error("Bad archive path: " + archivePath);
+
+    // 一卷切成的块数向上取整 (块不会跨卷)，队列至少能放一块
+    if (queueBytes == 0) queueBytes = std::min(volumeSize, VOLUME_QUEUE_MAX_BYTES);
+    const size_t queueChunks = static_cast<size_t>(std::max<uint64_t>(1, (queueBytes + chunkSize - 1) / chunkSize));
+
+    if (dirs.empty()) {
+        writers.push_back(std::make_unique<Writer>(parentOrCwd(archive), baseName, queueChunks));
+    } else {
+        for (const auto& d : dirs) {
+            writers.push_back(std::make_unique<Writer>(fs::u8path(d), baseName, queueChunks));
+        }
+    }
+    resetPutArea();
+}
+
+VolumeOutBuf::~VolumeOutBuf() {
+    // Writer 的析构负责关队列、等线程
+    writers.clear();
+}
+
+void VolumeOutBuf::resetPutArea() {
+    const uint64_t room = std::min<uint64_t>(chunkSize, volumeSize - volumeBytes);
+    setp(buffer.data(), buffer.data() + room);
+}
+
+void VolumeOutBuf::pushChunk() {
+    const size_t n = static_cast<size_t>(pptr() - pbase());
+    if (n == 0) return;
+
+    Chunk chunk;
+    chunk.volume = volume;
+    chunk.data.assign(pbase(), pptr());
+    volumeBytes += n;
+    if (volumeBytes == volumeSize) {
+        chunk.endOfVolume = true;
+        volume++;
+        volumeBytes = 0;
+    }
+    lastVolume = chunk.volume;
+    writers[(chunk.volume - 1) % writers.size()]->queue.push(std::move(chunk));
+    resetPutArea();
+}
+
+VolumeOutBuf::int_type VolumeOutBuf::overflow(int_type ch) {
+    if (closed) return traits_type::eof();
+    pushChunk();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int VolumeOutBuf::sync() {
+    if (!closed) pushChunk();
+    return 0;
+}
+
+void VolumeOutBuf::close() {
+    if (closed) return;
+    pushChunk();
+    closed = true;
+
+    std::string error;
+    for (auto& w : writers) {
+        w->queue.close();
+        w->thread.join();
+        if (error.empty()) error = w->error;
+    }
+    if (!error.empty()) throw std::runtime_error(error);
+
+    // 上次打包如果卷数更多，把多出来的旧卷删掉，免得解包时被当成同一套
+    std::error_code ec;
+    for (unsigned index = lastVolume + 1;; ++index) {
+        bool removed = false;
+        for (const auto& w : writers) removed |= fs::remove(w->dir / fs::u8path(volumeFileName(baseName, index)), ec);
+        if (!removed) break;
+    }
+}
+
+// ==========================================
+// 读分卷
+// ==========================================
+
+// 每个目录一个预读线程，按卷号顺序把自己负责的卷分块读进队列
+struct VolumeInBuf::Reader {
+    std::vector<std::string> paths;
+    ChunkQueue queue;
+    std::thread thread;
+
+    ~Reader() {
+        queue.close();
+        if (thread.joinable()) thread.join();
+    }
+
+    void run(size_t chunkSize) {
+        for (const auto& path : paths) {
+            std::ifstream in(fs::u8path(path), std::ios::binary);
+            if (!in.is_open()) {
+                Chunk failed;
+                failed.error = "Cannot open volume: " + path;
+                queue.push(std::move(failed));
+                return;
+            }
+            for (;;) {
+                Chunk chunk;
+                chunk.data.resize(chunkSize);
+                in.read(chunk.data.data(), static_cast<std::streamsize>(chunkSize));
+                chunk.data.resize(static_cast<size_t>(in.gcount()));
+                if (in.bad()) {
+                    chunk.data.clear();
+                    chunk.error = "Read volume failed: " + path;
+                    queue.push(std::move(chunk));
+                    return;
+                }
+                const bool last = in.eof();
+                chunk.endOfVolume = last;
+                if (!queue.push(std::move(chunk))) return;
+                if (last) break;
+            }
+        }
+    }
+};
+
+std::vector<std::string> VolumeInBuf::locate(const std::string& archivePath, const std::vector<std::string>& dirs) {
+    std::string base = archivePath;
+    const std::string first = ".001";
+    const bool namedFirst = base.size() > first.size() && base.compare(base.size() - first.size(), first.size(), first) == 0;
+    if (namedFirst) {
+        base.resize(base.size() - first.size());
+    } else {
+        std::error_code ec;
+        if (fs::is_regular_file(fs::u8path(archivePath), ec)) return {};
+    }
+
+    const fs::path basePath = fs::u8path(base);
+    const std::string baseName = basePath.filename().u8string();
+    std::vector<fs::path> searchDirs{parentOrCwd(basePath)};
+    for (const auto& d : dirs) searchDirs.push_back(fs::u8path(d));
+
+    std::vector<std::string> volumes;
+    for (unsigned index = 1;; ++index) {
+        const std::string name = volumeFileName(baseName, index);
+        bool found = false;
+        for (const auto& d : searchDirs) {
+            std::error_code ec;
+            const fs::path candidate = d / fs::u8path(name);
+            if (fs::is_regular_file(candidate, ec)) {
+                volumes.push_back(candidate.u8string());
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+    }
+    return volumes;
+}
+
+VolumeInBuf::VolumeInBuf(const std::vector<std::string>& volumes, size_t chunkSize) {
+    // 同一目录 (同一块盘) 的卷交给同一个线程顺序读，不同目录并行
+    std::unordered_map<std::string, size_t> byDir;
+    for (const auto& path : volumes) {
+        const std::string dir = parentOrCwd(fs::u8path(path)).u8string();
+        auto it = byDir.find(dir);
+        if (it == byDir.end()) {
+            it = byDir.emplace(dir, readers.size()).first;
+            readers.push_back(std::make_unique<Reader>());
+        }
+        readers[it->second]->paths.push_back(path);
+        readerOf.push_back(it->second);
+    }
+    for (auto& r : readers) {
+        Reader* reader = r.get();
+        reader->thread = std::thread([reader, chunkSize] { reader->run(chunkSize); });
+    }
+    setg(nullptr, nullptr, nullptr);
+}
+
+VolumeInBuf::~VolumeInBuf() {
+    readers.clear();
+}
+
+VolumeInBuf::int_type VolumeInBuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    while (current < readerOf.size()) {
+        Chunk next;
+        if (!readers[readerOf[current]]->queue.pop(next)) throw std::runtime_error("Volume reader stopped");
+        if (!next.error.empty()) throw std::runtime_error(next.error);
+        if (next.endOfVolume) current++;
+        if (next.data.empty()) continue;
+
+        chunk.swap(next.data);
+        setg(chunk.data(), chunk.data(), chunk.data() + chunk.size());
+        return traits_type::to_int_type(*gptr());
+    }
+    return traits_type::eof();
+}
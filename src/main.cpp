@@ -18,23 +18,66 @@ void printUsage() {
               << "  [Basic Mode]\n"
               << "    backup  <src_dir> <dst_dir>          Mirror copy with checksum index\n"
               << "    restore <src_dir> <dst_dir>          Restore from mirror\n"
+              << "        [-diff]                          Only rewrite files that differ\n"
+              << "        [-delete]                        Also remove extra files (implies -diff)\n"
+              << "        [-threads n]                     Parallel compare/copy\n"
               << "    verify  <dst_dir>                    Check integrity of mirror\n\n"
+              << "  [Archive Check]\n"
+              << "    verify-pack <pck_file> [-pwd p] [-threads n]  Check archive blocks in parallel\n\n"
               << "  [Pro Mode (Pack/Unpack)]\n"
               << "    pack    <src> <pck_file> [options]   Create archive\n"
-              << "    unpack  <pck_file> <dst_dir> [pwd]   Extract archive\n\n"
+              << "    unpack  <pck_file> <dst_dir> [pwd]   Extract archive\n"
+              << "    (use '-' as <pck_file> to stream via stdout/stdin)\n\n"
               << "  [Pack Options]\n"
               << "    -pwd <password>      Set encryption password\n"
               << "    -xor                 Use XOR encryption\n"
               << "    -rc4                 Use RC4 encryption\n"
               << "    -rle                 Enable RLE compression\n"
+              << "    -auto                Pick a codec per file (extension + entropy sampling)\n"
+              << "    -dedup               Store identical file contents only once\n"
+              << "    -blockcrc            Store CRC32C per 1 MiB block (for verify-pack)\n"
+              << "    -blocksize <bytes>   Checksum block size (multiple of 4096)\n"
+              << "    -base <pck_file>     Store only deltas against a previous full archive\n"
+              << "                         (a delta archive cannot be a base: diff nightly against the last full)\n"
+              << "    -io <backend>        Small-file I/O: auto | uring | threads | sync\n"
+              << "    -volume-size <n>     Split into <pck_file>.001, .002 ... of n bytes (K/M/G suffix)\n"
+              << "    -volume-dir <dir>    Round-robin volumes across dirs (repeat for each disk)\n"
+              << "    -volume-queue <n>    Bytes buffered per volume dir (default: one volume, max 64M);\n"
+              << "                         the next volume starts only once the current one is queued\n"
               << "    -name <str>          Filter by filename (contains)\n"
               << "    -path <str>          Filter by path (contains)\n"
               << "    -min <bytes>         Min file size\n"
               << "    -max <bytes>         Max file size\n"
-              << "    -days <n>            Only files modified in last N days\n"
+              << "    -days <n>            Only files modified in last N days\n\n"
+              << "  [Unpack Options]\n"
+              << "    -pwd <password>      Decryption password\n"
+              << "    -direct <bytes>      Write files >= N bytes with O_DIRECT\n"
+              << "    -base <pck_file>     Base archive for a delta archive\n"
+              << "    -io <backend>        Small-file I/O: auto | uring | threads | sync\n"
+              << "    -volume-dir <dir>    Also look for volumes in dir (repeatable)\n"
               << std::endl;
 }
 
+IoBackendKind parseIoBackend(const std::string& name) {
+    if (name == "uring") return IoBackendKind::URING;
+    if (name == "threads") return IoBackendKind::THREADS;
+    if (name == "sync") return IoBackendKind::SYNC;
+    if (name == "auto") return IoBackendKind::AUTO;
+    throw std::runtime_error("Unknown I/O backend: " + name);
+}
+
+// 字节数，支持 K / M / G 后缀 (1024 进制)
+uint64_t parseSize(const std::string& text) {
+    size_t used = 0;
+    uint64_t value = std::stoull(text, &used);
+    const std::string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") value <<= 10;
+    else if (suffix == "M" || suffix == "m") value <<= 20;
+    else if (suffix == "G" || suffix == "g") value <<= 30;
+    else if (!suffix.empty()) throw std::runtime_error("Bad size: " + text);
+    return value;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         printUsage();
@@ -42,6 +85,7 @@ int main(int argc, char* argv[]) {
     }
 
     const std::string command = argv[1];
+    BackupEngine engine;
 
     try {
         // ==========================================
@@ -49,14 +93,26 @@ int main(int argc, char* argv[]) {
         // ==========================================
         if (command == "backup") {
             if (argc < 4) { printUsage(); return 1; }
-            BackupEngine::backup(argv[2], argv[3]);
+            engine.backup(argv[2], argv[3]);
 
         // ==========================================
         // 2. Basic Restore
         // ==========================================
         } else if (command == "restore") {
             if (argc < 4) { printUsage(); return 1; }
-            BackupEngine::restore(argv[2], argv[3]);
+            RestoreOptions opts;
+            for (int i = 4; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "-diff") {
+                    opts.differential = true;
+                } else if (arg == "-delete") {
+                    opts.differential = true;
+                    opts.deleteExtra = true;
+                } else if (arg == "-threads" && i + 1 < argc) {
+                    opts.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+                }
+            }
+            engine.restore(argv[2], argv[3], opts);
             std::cout << GREEN << "Restore complete." << RESET << std::endl;
 
         // ==========================================
@@ -64,7 +120,7 @@ int main(int argc, char* argv[]) {
         // ==========================================
         } else if (command == "verify") {
             if (argc < 3) { printUsage(); return 1; }
-            std::string result = BackupEngine::verify(argv[2]);
+            std::string result = engine.verify(argv[2]);
             if (result.empty()) {
                 std::cout << GREEN << "[PASS] Integrity Check Passed." << RESET << std::endl;
             } else {
@@ -72,6 +128,26 @@ int main(int argc, char* argv[]) {
                 return 1; // Return error code for scripts
             }
 
+        // ==========================================
+        // 3.1 Archive Verify (包校验)
+        // ==========================================
+        } else if (command == "verify-pack") {
+            if (argc < 3) { printUsage(); return 1; }
+            std::string pwd;
+            unsigned threads = 0;
+            for (int i = 3; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "-pwd" && i + 1 < argc) pwd = argv[++i];
+                else if (arg == "-threads" && i + 1 < argc) threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            }
+            std::string result = engine.verifyPack(argv[2], pwd, threads);
+            if (result.empty()) {
+                std::cout << GREEN << "[PASS] Archive Check Passed." << RESET << std::endl;
+            } else {
+                std::cout << RED << "[FAIL] Archive Check Failed:" << RESET << "\n" << result << std::endl;
+                return 1;
+            }
+
         // ==========================================
         // 4. Pro Pack (高级打包)
         // ==========================================
@@ -87,6 +163,7 @@ int main(int argc, char* argv[]) {
             std::string pwd = "";
             EncryptionMode enc = EncryptionMode::NONE;
             CompressionMode comp = CompressionMode::NONE;
+            PackOptions packOpts;
             FilterOptions filter;
             filter.type = -1;      // Default: All types
             filter.targetUid = -1; // Default: Any UID
@@ -102,6 +179,24 @@ int main(int argc, char* argv[]) {
                     enc = EncryptionMode::RC4;
                 } else if (arg == "-rle") {
                     comp = CompressionMode::RLE;
+                } else if (arg == "-auto") {
+                    comp = CompressionMode::AUTO;
+                } else if (arg == "-dedup") {
+                    packOpts.dedup = true;
+                } else if (arg == "-blockcrc") {
+                    if (packOpts.checksumBlockSize == 0) packOpts.checksumBlockSize = DEFAULT_CHECKSUM_BLOCK;
+                } else if ((arg == "-base" || arg == "--base") && i + 1 < argc) {
+                    packOpts.baseArchive = argv[++i];
+                } else if (arg == "-io" && i + 1 < argc) {
+                    packOpts.ioBackend = parseIoBackend(argv[++i]);
+                } else if (arg == "-volume-size" && i + 1 < argc) {
+                    packOpts.volumeSize = parseSize(argv[++i]);
+                } else if (arg == "-volume-dir" && i + 1 < argc) {
+                    packOpts.volumeDirs.push_back(argv[++i]);
+                } else if (arg == "-volume-queue" && i + 1 < argc) {
+                    packOpts.volumeQueueSize = parseSize(argv[++i]);
+                } else if (arg == "-blocksize" && i + 1 < argc) {
+                    packOpts.checksumBlockSize = static_cast<uint32_t>(std::stoul(argv[++i]));
                 } else if (arg == "-name" && i + 1 < argc) {
                     filter.nameContains = argv[++i];
                 } else if (arg == "-path" && i + 1 < argc) {
@@ -118,12 +213,19 @@ int main(int argc, char* argv[]) {
                 }
             }
 
-            std::cout << "Packing " << src << " -> " << dest << " ..." << std::endl;
-            if (enc != EncryptionMode::NONE) std::cout << "Encryption: Enabled" << std::endl;
-            if (comp != CompressionMode::NONE) std::cout << "Compression: RLE" << std::endl;
+            // 输出到 stdout 时，提示信息全部改走 stderr，避免污染数据流
+            std::ostream& log = (dest == "-") ? std::cerr : std::cout;
+            log << "Packing " << src << " -> " << dest << " ..." << std::endl;
+            if (enc != EncryptionMode::NONE) log << "Encryption: Enabled" << std::endl;
+            if (comp == CompressionMode::RLE) log << "Compression: RLE" << std::endl;
+            else if (comp == CompressionMode::AUTO) log << "Compression: Auto (per entry)" << std::endl;
+            if (packOpts.dedup) log << "Dedup: Enabled" << std::endl;
+            if (packOpts.checksumBlockSize) log << "Block Checksum: " << packOpts.checksumBlockSize << " bytes" << std::endl;
+            if (!packOpts.baseArchive.empty()) log << "Delta Base: " << packOpts.baseArchive << std::endl;
+            if (packOpts.volumeSize) log << "Volume Size: " << packOpts.volumeSize << " bytes" << std::endl;
 
-            BackupEngine::pack(src, dest, pwd, enc, filter, comp);
-            std::cout << GREEN << "[SUCCESS] Pack created." << RESET << std::endl;
+            engine.pack(src, dest, pwd, enc, filter, comp, packOpts);
+            log << GREEN << "[SUCCESS] Pack created." << RESET << std::endl;
 
         // ==========================================
         // 5. Pro Unpack (高级解包)
@@ -138,18 +240,28 @@ int main(int argc, char* argv[]) {
             std::string dest = argv[3];
             std::string pwd = "";
 
-            // 简单的参数检查，支持 unpack pck dst pwd 这种旧格式，也支持 -pwd
-            if (argc >= 5) {
-                std::string arg4 = argv[4];
-                if (arg4 == "-pwd" && argc >= 6) {
-                    pwd = argv[5];
+            UnpackOptions opts;
+
+            // 支持 unpack pck dst pwd 这种旧格式，也支持 -pwd / -direct
+            for (int i = 4; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "-pwd" && i + 1 < argc) {
+                    pwd = argv[++i];
+                } else if (arg == "-direct" && i + 1 < argc) {
+                    opts.directIoMinSize = std::stoull(argv[++i]);
+                } else if ((arg == "-base" || arg == "--base") && i + 1 < argc) {
+                    opts.baseArchive = argv[++i];
+                } else if (arg == "-io" && i + 1 < argc) {
+                    opts.ioBackend = parseIoBackend(argv[++i]);
+                } else if (arg == "-volume-dir" && i + 1 < argc) {
+                    opts.volumeDirs.push_back(argv[++i]);
                 } else {
-                    pwd = arg4; // 兼容旧写法
+                    pwd = arg; // 兼容旧写法
                 }
             }
 
             std::cout << "Unpacking " << pck << " -> " << dest << " ..." << std::endl;
-            BackupEngine::unpack(pck, dest, pwd);
+            engine.unpack(pck, dest, pwd, opts);
             std::cout << GREEN << "[SUCCESS] Unpack complete & Verified." << RESET << std::endl;
 
         } else {
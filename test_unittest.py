@@ -4,6 +4,9 @@ import os
 import shutil
 import time
 import platform
+import threading
+import subprocess
+import zlib
 
 # ==========================================
 # C 结构体定义 (已对齐)
@@ -20,6 +23,51 @@ class CFilter(ctypes.Structure):
         ("targetUid", ctypes.c_int)
     ]
 
+# 内存条目 (与 Bridge.cpp 的 CMemEntry 一致)
+class CMemEntry(ctypes.Structure):
+    _fields_ = [
+        ("relPath", ctypes.c_char_p),
+        ("data", ctypes.c_void_p),
+        ("size", ctypes.c_ulonglong),
+        ("type", ctypes.c_int),
+        ("mode", ctypes.c_uint),
+        ("uid", ctypes.c_uint),
+        ("gid", ctypes.c_uint),
+        ("mtime", ctypes.c_longlong)
+    ]
+
+CSinkFn = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_ulonglong)
+CVisitFn = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.POINTER(CMemEntry))
+CLogFn = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int, ctypes.c_char_p)
+CCodecFn = ctypes.CFUNCTYPE(ctypes.c_ulonglong, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_ulonglong,
+                            ctypes.c_void_p, ctypes.c_ulonglong)
+CEstimateFn = ctypes.CFUNCTYPE(ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_ulonglong)
+
+# 打包统计 (与 Bridge.cpp 的 CPackStats 一致)
+class CPackStats(ctypes.Structure):
+    _fields_ = [
+        ("items", ctypes.c_int),
+        ("dedupRefs", ctypes.c_int),
+        ("deltaEntries", ctypes.c_int),
+        ("compressedEntries", ctypes.c_int),
+        ("dedupBytes", ctypes.c_ulonglong),
+        ("deltaBytes", ctypes.c_ulonglong)
+    ]
+
+# 打包选项 (与 Bridge.cpp 的 CPackOptions 一致)
+class CPackOptions(ctypes.Structure):
+    _fields_ = [
+        ("dedup", ctypes.c_int),
+        ("checksumBlockSize", ctypes.c_uint),
+        ("baseArchive", ctypes.c_char_p)
+    ]
+
+# 解包选项 (与 Bridge.cpp 的 CUnpackOptions 一致)
+class CUnpackOptions(ctypes.Structure):
+    _fields_ = [
+        ("baseArchive", ctypes.c_char_p)
+    ]
+
 # ==========================================
 # 单元测试类
 # ==========================================
@@ -49,6 +97,8 @@ class TestMiniBackup(unittest.TestCase):
             raise RuntimeError("Cannot find core library! Please build first.")
 
         cls.lib = ctypes.cdll.LoadLibrary(lib_path)
+        # 命令行程序与库在同一个构建目录
+        cls.cli = os.path.join(os.path.dirname(lib_path), "minibackup.exe" if platform.system() == "Windows" else "minibackup")
 
         # 设置函数参数类型
         cls.lib.C_PackWithFilter.argtypes = [
@@ -56,6 +106,54 @@ class TestMiniBackup(unittest.TestCase):
             ctypes.c_int, ctypes.POINTER(CFilter), ctypes.c_int
         ]
         cls.lib.C_Unpack.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p]
+        cls.lib.C_VerifyPack.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+        cls.lib.C_VerifyPack.restype = ctypes.c_char_p
+        cls.lib.C_PackMemory.argtypes = [
+            ctypes.POINTER(CMemEntry), ctypes.c_int, ctypes.c_char_p,
+            ctypes.c_int, ctypes.c_int, CSinkFn, ctypes.c_void_p
+        ]
+        cls.lib.C_UnpackMemory.argtypes = [
+            ctypes.c_void_p, ctypes.c_ulonglong, ctypes.c_char_p, CVisitFn, ctypes.c_void_p
+        ]
+        cls.lib.C_EngineCreate.argtypes = [CLogFn, ctypes.c_void_p]
+        cls.lib.C_EngineCreate.restype = ctypes.c_void_p
+        cls.lib.C_EngineDestroy.argtypes = [ctypes.c_void_p]
+        cls.lib.C_EnginePack.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+            ctypes.c_int, ctypes.POINTER(CFilter), ctypes.c_int
+        ]
+        cls.lib.C_EnginePackEx.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+            ctypes.c_int, ctypes.POINTER(CFilter), ctypes.c_int, ctypes.POINTER(CPackOptions)
+        ]
+        cls.lib.C_PackMemoryEx.argtypes = [
+            ctypes.POINTER(CMemEntry), ctypes.c_int, ctypes.c_char_p, ctypes.c_int, ctypes.c_int,
+            ctypes.POINTER(CPackOptions), CSinkFn, ctypes.c_void_p
+        ]
+        cls.lib.C_EngineVerifyPack.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        cls.lib.C_EngineVerifyPack.restype = ctypes.c_char_p
+        cls.lib.C_EngineRestore.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_int
+        ]
+        cls.lib.C_BackupSimple.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+        cls.lib.C_EngineLastStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(CPackStats)]
+        cls.lib.C_EnginePackVolumes.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+            ctypes.c_int, ctypes.POINTER(CFilter), ctypes.c_int,
+            ctypes.c_ulonglong, ctypes.POINTER(ctypes.c_char_p), ctypes.c_int
+        ]
+        cls.lib.C_EngineLastError.argtypes = [ctypes.c_void_p]
+        cls.lib.C_EngineLastError.restype = ctypes.c_char_p
+        cls.lib.C_EngineUnpackVolumes.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+            ctypes.POINTER(ctypes.c_char_p), ctypes.c_int
+        ]
+        cls.lib.C_RegisterCodec.argtypes = [
+            ctypes.c_int, ctypes.c_char_p, CCodecFn, CCodecFn, CEstimateFn, ctypes.c_void_p
+        ]
+        cls.lib.C_EngineUnpackEx.argtypes = [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(CUnpackOptions)
+        ]
 
     # [每个测试前] 准备干净的临时目录
     def setUp(self):
@@ -250,6 +348,466 @@ class TestMiniBackup(unittest.TestCase):
         with open(deep_path, "rb") as f:
             self.assertTrue(b"#include" in f.read())
 
+    def test_06_verify_pack(self):
+        """测试包校验：完好的包通过，篡改一个字节后报错"""
+        self.create_dummy_file("data.bin", bytes(range(256)) * 64)
+        pck_path = os.path.join(self.test_dir, "check.pck")
+        self.lib.C_PackWithFilter(self.src_dir.encode(), pck_path.encode(), b"", 0, None, 0)
+
+        self.assertEqual(self.lib.C_VerifyPack(pck_path.encode(), b""), b"", "Intact pack should pass")
+
+        # 翻转数据区最后一个字节
+        with open(pck_path, "r+b") as f:
+            f.seek(-1, os.SEEK_END)
+            b = f.read(1)
+            f.seek(-1, os.SEEK_END)
+            f.write(bytes([b[0] ^ 0xFF]))
+
+        msg = self.lib.C_VerifyPack(pck_path.encode(), b"")
+        self.assertIn("data.bin", msg.decode("utf-8"), "Corruption not reported")
+
+    def test_07_memory_roundtrip(self):
+        """测试内存接口：内存打包 -> 内存解包，不经过任何文件"""
+        payloads = {b"conf/app.ini": b"[main]\nkey=value\n" * 20, b"conf/empty.txt": b""}
+
+        # 用 bytearray + from_buffer 把缓冲区零拷贝交给 C++
+        buffers = [bytearray(v) for v in payloads.values()]
+        entries = (CMemEntry * len(payloads))()
+        for k, (name, buf) in enumerate(zip(payloads.keys(), buffers)):
+            entries[k].relPath = name
+            entries[k].data = ctypes.addressof((ctypes.c_char * len(buf)).from_buffer(buf)) if buf else None
+            entries[k].size = len(buf)
+            entries[k].type = 0
+            entries[k].mode = 0o644
+            entries[k].mtime = 1577836800
+
+        chunks = []
+        sink = CSinkFn(lambda ctx, data, size: chunks.append(ctypes.string_at(data, size)) or 1)
+        res = self.lib.C_PackMemory(entries, len(payloads), b"pwd", 2, 1, sink, None)
+        self.assertEqual(res, 1, "Memory pack failed")
+        blob = bytearray(b"".join(chunks))
+
+        result = {}
+        def on_entry(ctx, entry):
+            e = entry.contents
+            result[e.relPath] = ctypes.string_at(e.data, e.size) if e.size else b""
+            return 1
+        visit = CVisitFn(on_entry)
+        view = (ctypes.c_char * len(blob)).from_buffer(blob)
+        res = self.lib.C_UnpackMemory(ctypes.addressof(view), len(blob), b"pwd", visit, None)
+        self.assertEqual(res, 1, "Memory unpack failed")
+        self.assertEqual(result, payloads)
+
+    def test_08_auto_codec(self):
+        """测试逐条目 codec：可压缩文件走 RLE，随机数据原样存储不膨胀"""
+        noise = os.urandom(64 * 1024)
+        self.create_dummy_file("zeros.img", b"\0" * 64 * 1024)
+        self.create_dummy_file("noise.bin", noise)
+        self.create_dummy_file("photo.jpg", noise[:4096])
+        pck_path = os.path.join(self.test_dir, "auto.pck")
+
+        # Compress: AUTO (2)
+        res = self.lib.C_PackWithFilter(self.src_dir.encode(), pck_path.encode(), b"", 0, None, 2)
+        self.assertEqual(res, 1, "Pack failed")
+        # 随机数据若被强行 RLE 会膨胀到约 2 倍
+        self.assertLess(os.path.getsize(pck_path), 64 * 1024 + 4096 + 4096)
+
+        self.lib.C_Unpack(pck_path.encode(), self.out_dir.encode(), b"")
+        with open(os.path.join(self.out_dir, "noise.bin"), "rb") as f:
+            self.assertEqual(f.read(), noise)
+        with open(os.path.join(self.out_dir, "zeros.img"), "rb") as f:
+            self.assertEqual(f.read(), b"\0" * 64 * 1024)
+
+    def test_09_engine_handles(self):
+        """测试句柄接口：多个任务在同一进程内并发，结果、日志、统计互不串扰"""
+        jobs = 4
+        logs = [[] for _ in range(jobs)]
+        # 回调对象必须活得比句柄久
+        log_fns = [CLogFn(lambda ctx, level, msg, k=k: logs[k].append(msg.decode("utf-8"))) for k in range(jobs)]
+        handles = [self.lib.C_EngineCreate(log_fns[k], None) for k in range(jobs)]
+        self.assertTrue(all(handles), "Engine create failed")
+
+        results = [None] * jobs
+        def run(k):
+            src = os.path.join(self.test_dir, f"src{k}")
+            os.makedirs(src)
+            for n in range(k + 1):
+                with open(os.path.join(src, f"f{n}.bin"), "wb") as f:
+                    f.write(bytes([k]) * 50000)
+            pck = os.path.join(self.test_dir, f"job{k}.pck")
+            self.lib.C_EnginePack(handles[k], src.encode(), pck.encode(), b"", 0, None, 0)
+            # 偶数号任务篡改自己的包
+            if k % 2 == 0:
+                with open(pck, "r+b") as f:
+                    f.seek(-1, os.SEEK_END)
+                    f.write(b"\xff")
+            stats = CPackStats()
+            self.lib.C_EngineLastStats(handles[k], ctypes.byref(stats))
+            results[k] = (self.lib.C_EngineVerifyPack(handles[k], pck.encode(), b"").decode("utf-8"), stats.items)
+
+        threads = [threading.Thread(target=run, args=(k,)) for k in range(jobs)]
+        for t in threads: t.start()
+        for t in threads: t.join()
+
+        for k in range(jobs):
+            msg, items = results[k]
+            self.assertEqual(items, k + 1, "Stats leaked between handles")
+            if k % 2 == 0:
+                self.assertIn(".bin", msg, "Corruption not reported")
+            else:
+                self.assertEqual(msg, "", "Intact pack should pass")
+            self.assertIn(f"[Pack] Done. Items: {k + 1}", logs[k])
+        for h in handles:
+            self.lib.C_EngineDestroy(h)
+
+    def test_10_differential_restore(self):
+        """测试差异恢复：只修复被改动的文件，删除多余文件，未改动的文件不重写"""
+        self.create_dummy_file("keep.txt", b"unchanged" * 100)
+        self.create_dummy_file("edit.txt", b"original" * 100)
+        mirror = os.path.join(self.test_dir, "mirror")
+        self.lib.C_BackupSimple(self.src_dir.encode(), mirror.encode())
+
+        logs = []
+        log_fn = CLogFn(lambda ctx, level, msg: logs.append(msg.decode("utf-8")))
+        h = self.lib.C_EngineCreate(log_fn, None)
+        self.assertEqual(self.lib.C_EngineRestore(h, mirror.encode(), self.out_dir.encode(), 1, 1), 1)
+
+        # 模拟目标被改动: 同大小改内容 + 多出一个文件
+        edit_path = os.path.join(self.out_dir, "edit.txt")
+        with open(edit_path, "wb") as f:
+            f.write(b"tampered" * 100)
+        os.utime(edit_path, (0, 0))
+        self.create_dummy_file("../out/extra.log", b"junk")
+
+        self.assertEqual(self.lib.C_EngineRestore(h, mirror.encode(), self.out_dir.encode(), 1, 1), 1)
+        with open(edit_path, "rb") as f:
+            self.assertEqual(f.read(), b"original" * 100)
+        self.assertFalse(os.path.exists(os.path.join(self.out_dir, "extra.log")))
+        self.assertIn("[Restore] Copied: 1, Unchanged: 1, Deleted: 1, Failed: 0", logs)
+        self.lib.C_EngineDestroy(h)
+
+    def test_11_volumes(self):
+        """测试分卷：条目跨卷、分卷轮流写到两个目录，缺卷时报截断"""
+        big = bytes(range(256)) * 1000
+        self.create_dummy_file("big.bin", big)
+        self.create_dummy_file("small.txt", b"tiny")
+        disks = [os.path.join(self.test_dir, d) for d in ("disk1", "disk2")]
+        for d in disks:
+            os.makedirs(d)
+        dirs = (ctypes.c_char_p * 2)(*[d.encode() for d in disks])
+        pck = os.path.join(disks[0], "set.pck")
+
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+        self.assertEqual(self.lib.C_EnginePackVolumes(
+            h, self.src_dir.encode(), pck.encode(), b"secret", 2, None, 0, 64 * 1024, dirs, 2), 1)
+        self.assertTrue(os.path.exists(os.path.join(disks[0], "set.pck.001")))
+        self.assertTrue(os.path.exists(os.path.join(disks[1], "set.pck.002")))
+        self.assertLessEqual(os.path.getsize(os.path.join(disks[0], "set.pck.001")), 64 * 1024)
+
+        self.assertEqual(self.lib.C_EngineUnpackVolumes(
+            h, pck.encode(), self.out_dir.encode(), b"secret", dirs, 2), 1)
+        with open(os.path.join(self.out_dir, "big.bin"), "rb") as f:
+            self.assertEqual(f.read(), big)
+
+        os.remove(os.path.join(disks[1], "set.pck.004"))
+        broken = os.path.join(self.test_dir, "broken")
+        self.assertEqual(self.lib.C_EngineUnpackVolumes(
+            h, pck.encode(), broken.encode(), b"secret", dirs, 2), 0)
+        self.assertIn("Truncated", self.lib.C_EngineLastError(h).decode("utf-8"))
+        self.lib.C_EngineDestroy(h)
+
+    def test_12_dedup(self):
+        """测试去重：包比不去重时小，每个重复文件都按字节还原，并带回各自的权限和时间"""
+        content = bytearray(os.urandom(40000))
+        view = ctypes.addressof((ctypes.c_char * len(content)).from_buffer(content))
+        meta = {b"a.bin": (0o644, 1600000000), b"b.bin": (0o600, 1600001000), b"c.bin": (0o755, 1600002000)}
+        entries = (CMemEntry * len(meta))()
+        for k, (name, (mode, mtime)) in enumerate(meta.items()):
+            entries[k].relPath = name
+            entries[k].data = view
+            entries[k].size = len(content)
+            entries[k].type = 0
+            entries[k].mode = mode
+            entries[k].mtime = mtime
+
+        def pack(opts):
+            chunks = []
+            sink = CSinkFn(lambda ctx, data, size: chunks.append(ctypes.string_at(data, size)) or 1)
+            self.assertEqual(self.lib.C_PackMemoryEx(entries, len(meta), b"", 0, 0, opts, sink, None), 1)
+            return b"".join(chunks)
+
+        plain = pack(None)
+        dedup = pack(ctypes.byref(CPackOptions(dedup=1)))
+        self.assertLess(len(dedup) + len(content), len(plain), "Duplicates stored more than once")
+
+        # 落盘后走文件解包，重复条目由首份内容复制出来
+        pck_path = os.path.join(self.test_dir, "dedup.pck")
+        with open(pck_path, "wb") as f:
+            f.write(dedup)
+        self.assertEqual(self.lib.C_Unpack(pck_path.encode(), self.out_dir.encode(), b""), 1)
+        for name, (mode, mtime) in meta.items():
+            out = os.path.join(self.out_dir, name.decode())
+            with open(out, "rb") as f:
+                self.assertEqual(f.read(), bytes(content), name)
+            if platform.system() != "Windows":
+                self.assertEqual(os.stat(out).st_mode & 0o777, mode, name)
+            self.assertEqual(int(os.stat(out).st_mtime), mtime, name)
+
+    def test_13_verify_block_crc(self):
+        """测试分块校验：数据块损坏定位到字节范围，条目头 (mtime) 被改也能发现"""
+        data = bytes(range(256)) * 64  # 16 KiB = 4 块
+        self.create_dummy_file("f.bin", data)
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+        opts = CPackOptions(dedup=0, checksumBlockSize=4096)
+
+        def make_pack(name):
+            path = os.path.join(self.test_dir, name)
+            self.assertEqual(self.lib.C_EnginePackEx(
+                h, self.src_dir.encode(), path.encode(), b"", 0, None, 0, ctypes.byref(opts)), 1)
+            self.assertEqual(self.lib.C_EngineVerifyPack(h, path.encode(), b""), b"", "Intact pack should pass")
+            return path
+
+        def flip(path, offset):
+            with open(path, "r+b") as f:
+                f.seek(offset)
+                b = f.read(1)
+                f.seek(offset)
+                f.write(bytes([b[0] ^ 0x01]))
+
+        # 包头 13 字节 (magic + flag + blockSize)，条目头 41 + 路径，随后 4 字节头校验
+        header_start = 13
+        mtime_offset = header_start + 1 + 8 + len("f.bin") + 8 + 4 + 12
+        payload_start = header_start + 41 + len("f.bin") + 4
+
+        block_pack = make_pack("block.pck")
+        flip(block_pack, payload_start + 4096 + 10)
+        msg = self.lib.C_EngineVerifyPack(h, block_pack.encode(), b"").decode("utf-8")
+        self.assertIn("f.bin", msg)
+        self.assertIn("[4096, 8192)", msg)
+
+        # 抢救出的文件照常写出 (坏块清零)，但解包必须报失败
+        self.assertEqual(self.lib.C_EngineUnpackEx(h, block_pack.encode(), self.out_dir.encode(), b"", None), 0)
+        self.assertIn("salvaged", self.lib.C_EngineLastError(h).decode("utf-8"))
+        with open(os.path.join(self.out_dir, "f.bin"), "rb") as f:
+            salvaged = f.read()
+        self.assertEqual(salvaged[:4096], data[:4096])
+        self.assertEqual(salvaged[4096:8192], bytes(4096))
+        self.assertEqual(salvaged[8192:], data[8192:])
+
+        header_pack = make_pack("header.pck")
+        flip(header_pack, mtime_offset)
+        msg = self.lib.C_EngineVerifyPack(h, header_pack.encode(), b"").decode("utf-8")
+        self.assertIn("checksum mismatch", msg)
+        self.lib.C_EngineDestroy(h)
+
+    def test_14_delta_roundtrip(self):
+        """测试差量：基准包为分卷包，改/删/增文件后差量打包再还原；缺基准包、基准包不对时不写出任何文件"""
+        edit = bytearray(os.urandom(64 * 1024))
+        self.create_dummy_file("edit.bin", bytes(edit))
+        self.create_dummy_file("gone.txt", b"to be deleted")
+        self.create_dummy_file("same.txt", b"unchanged")
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+
+        base = os.path.join(self.test_dir, "base.pck")
+        self.assertEqual(self.lib.C_EnginePackVolumes(
+            h, self.src_dir.encode(), base.encode(), b"pw", 2, None, 0, 16 * 1024, None, 0), 1)
+        self.assertTrue(os.path.exists(base + ".002"))
+
+        edit[1000:1010] = b"0123456789"
+        self.create_dummy_file("edit.bin", bytes(edit))
+        os.remove(os.path.join(self.src_dir, "gone.txt"))
+        self.create_dummy_file("new.txt", b"added later")
+
+        delta = os.path.join(self.test_dir, "delta.pck")
+        opts = CPackOptions(dedup=0, checksumBlockSize=0, baseArchive=base.encode())
+        self.assertEqual(self.lib.C_EnginePackEx(
+            h, self.src_dir.encode(), delta.encode(), b"pw", 2, None, 0, ctypes.byref(opts)), 1)
+        stats = CPackStats()
+        self.lib.C_EngineLastStats(h, ctypes.byref(stats))
+        self.assertGreaterEqual(stats.deltaEntries, 1)
+        self.assertLess(os.path.getsize(delta), len(edit) // 2, "Edited file not stored as delta")
+
+        # 缺基准包: 看包头就失败，不写出任何文件
+        no_base = os.path.join(self.test_dir, "no_base")
+        self.assertEqual(self.lib.C_EngineUnpackEx(h, delta.encode(), no_base.encode(), b"pw", None), 0)
+        self.assertIn("-base", self.lib.C_EngineLastError(h).decode("utf-8"))
+        self.assertFalse(os.path.exists(no_base) and os.listdir(no_base))
+
+        uopts = CUnpackOptions(baseArchive=base.encode())
+        self.assertEqual(self.lib.C_EngineUnpackEx(
+            h, delta.encode(), self.out_dir.encode(), b"pw", ctypes.byref(uopts)), 1)
+        for name in ("edit.bin", "same.txt", "new.txt"):
+            with open(os.path.join(self.out_dir, name), "rb") as f, \
+                 open(os.path.join(self.src_dir, name), "rb") as g:
+                self.assertEqual(f.read(), g.read(), name)
+        self.assertFalse(os.path.exists(os.path.join(self.out_dir, "gone.txt")))
+
+        # 差量包不能再做基准 (它的差量条目需要更早的包才能还原)
+        chained = os.path.join(self.test_dir, "chained.pck")
+        opts = CPackOptions(dedup=0, checksumBlockSize=0, baseArchive=delta.encode())
+        self.assertEqual(self.lib.C_EnginePackEx(
+            h, self.src_dir.encode(), chained.encode(), b"pw", 2, None, 0, ctypes.byref(opts)), 0)
+        self.assertIn("delta pack", self.lib.C_EngineLastError(h).decode("utf-8"))
+
+        # 内存打包同样支持基准包
+        content = (ctypes.c_char * len(edit)).from_buffer(edit)
+        entries = (CMemEntry * 1)()
+        entries[0].relPath = b"edit.bin"
+        entries[0].data = ctypes.addressof(content)
+        entries[0].size = len(edit)
+        entries[0].mode = 0o644
+        chunks = []
+        sink = CSinkFn(lambda ctx, data, size: chunks.append(ctypes.string_at(data, size)) or 1)
+        opts = CPackOptions(dedup=0, checksumBlockSize=0, baseArchive=base.encode())
+        self.assertEqual(self.lib.C_PackMemoryEx(entries, 1, b"pw", 2, 0, ctypes.byref(opts), sink, None), 1)
+        mem_delta = os.path.join(self.test_dir, "mem_delta.pck")
+        with open(mem_delta, "wb") as f:
+            f.write(b"".join(chunks))
+        self.assertLess(os.path.getsize(mem_delta), len(edit) // 2, "Memory pack ignored the base")
+        mem_out = os.path.join(self.test_dir, "mem_out")
+        uopts = CUnpackOptions(baseArchive=base.encode())
+        self.assertEqual(self.lib.C_EngineUnpackEx(
+            h, mem_delta.encode(), mem_out.encode(), b"pw", ctypes.byref(uopts)), 1)
+        with open(os.path.join(mem_out, "edit.bin"), "rb") as f:
+            self.assertEqual(f.read(), bytes(edit))
+
+        # 基准包不对 (同路径不同内容): 还原结果的 CRC 对不上，报错而不是写出错误内容
+        self.create_dummy_file("edit.bin", os.urandom(len(edit)))
+        wrong = os.path.join(self.test_dir, "wrong.pck")
+        self.assertEqual(self.lib.C_EnginePack(h, self.src_dir.encode(), wrong.encode(), b"pw", 2, None, 0), 1)
+        bad_out = os.path.join(self.test_dir, "bad_out")
+        uopts = CUnpackOptions(baseArchive=wrong.encode())
+        self.assertEqual(self.lib.C_EngineUnpackEx(
+            h, delta.encode(), bad_out.encode(), b"pw", ctypes.byref(uopts)), 0)
+        self.assertIn("Delta", self.lib.C_EngineLastError(h).decode("utf-8"))
+        self.assertFalse(os.path.exists(os.path.join(bad_out, "edit.bin")))
+        self.lib.C_EngineDestroy(h)
+
+    def test_15_truncated_unpack(self):
+        """测试截断包：解包报错，但损坏位置之前的小文件 (批量写) 都已落盘"""
+        names = ["f%03d.txt" % k for k in range(300)]
+        for name in names:
+            self.create_dummy_file(name, name.encode() * 4)
+        pck = os.path.join(self.test_dir, "full.pck")
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+        self.assertEqual(self.lib.C_EnginePack(h, self.src_dir.encode(), pck.encode(), b"", 0, None, 0), 1)
+        with open(pck, "rb") as f:
+            cut = f.read(7000)
+        broken = os.path.join(self.test_dir, "cut.pck")
+        with open(broken, "wb") as f:
+            f.write(cut)
+
+        self.assertEqual(self.lib.C_EngineUnpackEx(h, broken.encode(), self.out_dir.encode(), b"", None), 0)
+        restored = os.listdir(self.out_dir)
+        # 每个条目 41 字节头 + 8 字节路径 + 32 字节数据，截断处之前有 86 个完整条目
+        self.assertGreaterEqual(len(restored), (7000 - 9) // 81 - 1)
+        for name in restored:
+            with open(os.path.join(self.out_dir, name), "rb") as f:
+                self.assertEqual(f.read(), name.encode() * 4, name)
+        self.lib.C_EngineDestroy(h)
+
+    def test_16_restore_deletes_stray_symlinks(self):
+        """测试差异恢复删除多余条目：目标里指向保留文件的符号链接也要删掉，被指向的文件不受影响"""
+        if platform.system() == "Windows":
+            self.skipTest("symlinks need privileges on Windows")
+        os.makedirs(os.path.join(self.src_dir, "a", "b"))
+        os.makedirs(os.path.join(self.src_dir, "c"))
+        self.create_dummy_file("a/b/x.txt", b"kept")
+        self.create_dummy_file("rle.txt", b"A" * 100)
+        os.makedirs(os.path.join(self.src_dir, "sub"))
+        self.create_dummy_file("sub/f.txt", b"inside")
+        mirror = os.path.join(self.test_dir, "mirror")
+        self.lib.C_BackupSimple(self.src_dir.encode(), mirror.encode())
+
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+        self.assertEqual(self.lib.C_EngineRestore(h, mirror.encode(), self.out_dir.encode(), 1, 1), 1)
+        strays = [os.path.join(self.out_dir, "a", "stray_link"), os.path.join(self.out_dir, "c", "another")]
+        os.symlink("b/x.txt", strays[0])
+        os.symlink("../rle.txt", strays[1])
+        # 镜像里是真目录、目标里是指向外面的目录链接: 不能顺着链接写到目标之外
+        outside = os.path.join(self.test_dir, "outside")
+        os.makedirs(outside)
+        shutil.rmtree(os.path.join(self.out_dir, "sub"))
+        os.symlink(os.path.abspath(outside), os.path.join(self.out_dir, "sub"))
+
+        self.assertEqual(self.lib.C_EngineRestore(h, mirror.encode(), self.out_dir.encode(), 1, 1), 1)
+        for link in strays:
+            self.assertFalse(os.path.lexists(link), link)
+        with open(os.path.join(self.out_dir, "a", "b", "x.txt"), "rb") as f:
+            self.assertEqual(f.read(), b"kept")
+        with open(os.path.join(self.out_dir, "rle.txt"), "rb") as f:
+            self.assertEqual(f.read(), b"A" * 100)
+        self.assertFalse(os.path.islink(os.path.join(self.out_dir, "sub")))
+        with open(os.path.join(self.out_dir, "sub", "f.txt"), "rb") as f:
+            self.assertEqual(f.read(), b"inside")
+        self.assertEqual(os.listdir(outside), [])
+        self.lib.C_EngineDestroy(h)
+
+    def test_17_registered_codec(self):
+        """测试 codec 注册表：注册的 codec 由 AUTO 模式按 estimate 选中，打包解包往返一致"""
+        def run_codec(fn):
+            def call(ctx, data, size, out, capacity):
+                result = fn(ctypes.string_at(data, size))
+                if len(result) <= capacity:
+                    ctypes.memmove(out, result, len(result))
+                return len(result)
+            return CCodecFn(call)
+
+        # 只认带 "ZLIB:" 前缀的数据，其他条目照旧由内置 codec 处理
+        estimate = CEstimateFn(lambda ctx, data, size: 0.1 if ctypes.string_at(data, min(size, 5)) == b"ZLIB:" else 1.0)
+        fns = (run_codec(zlib.compress), run_codec(zlib.decompress), estimate)
+        type(self).codec_fns = fns  # 注册表里的回调要一直有效
+        self.assertEqual(self.lib.C_RegisterCodec(200, b"zlib", fns[0], fns[1], fns[2], None), 1)
+        self.assertEqual(self.lib.C_RegisterCodec(200, b"again", fns[0], fns[1], fns[2], None), 0)
+
+        # 无游程的文本: RLE 只会变大，只有注册的 codec 能压
+        text = b"ZLIB:" + b"".join(b"line %05d of some text\n" % k for k in range(2000))
+        self.create_dummy_file("text.log", text)
+        self.create_dummy_file("runs.bin", b"A" * 5000)
+        pck = os.path.join(self.test_dir, "codec.pck")
+        h = self.lib.C_EngineCreate(CLogFn(0), None)
+        self.assertEqual(self.lib.C_EnginePack(h, self.src_dir.encode(), pck.encode(), b"", 0, None, 2), 1)
+        stats = CPackStats()
+        self.lib.C_EngineLastStats(h, ctypes.byref(stats))
+        self.assertEqual(stats.compressedEntries, 2)
+        self.assertLess(os.path.getsize(pck), len(text) // 4, "Registered codec was not chosen")
+
+        self.assertEqual(self.lib.C_EngineUnpackEx(h, pck.encode(), self.out_dir.encode(), b"", None), 1)
+        with open(os.path.join(self.out_dir, "text.log"), "rb") as f:
+            self.assertEqual(f.read(), text)
+        with open(os.path.join(self.out_dir, "runs.bin"), "rb") as f:
+            self.assertEqual(f.read(), b"A" * 5000)
+        self.lib.C_EngineDestroy(h)
+
+    def test_18_stdio_pipe(self):
+        """测试流式管道：pack src - | unpack - dst 往返一致，管道中途断掉时报截断"""
+        if not os.path.exists(self.cli):
+            self.skipTest("minibackup executable not built")
+        big = os.urandom(300 * 1024)
+        self.create_dummy_file("big.bin", big)
+        self.create_dummy_file("small.txt", b"hello pipe")
+
+        packer = subprocess.Popen([self.cli, "pack", self.src_dir, "-", "-pwd", "pw", "-rc4"],
+                                  stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        unpacker = subprocess.run([self.cli, "unpack", "-", self.out_dir, "-pwd", "pw"],
+                                  stdin=packer.stdout, capture_output=True)
+        packer.stdout.close()
+        self.assertEqual(packer.wait(), 0)
+        self.assertEqual(unpacker.returncode, 0, unpacker.stderr.decode("utf-8", "replace"))
+        with open(os.path.join(self.out_dir, "big.bin"), "rb") as f:
+            self.assertEqual(f.read(), big)
+        with open(os.path.join(self.out_dir, "small.txt"), "rb") as f:
+            self.assertEqual(f.read(), b"hello pipe")
+
+        stream = subprocess.run([self.cli, "pack", self.src_dir, "-", "-pwd", "pw", "-rc4"],
+                                capture_output=True, check=True).stdout
+        # 只少了结束标记，或断在条目中间，都必须失败
+        for cut in (stream[:-1], stream[:len(stream) // 2]):
+            dst = os.path.join(self.test_dir, "cut_%d" % len(cut))
+            result = subprocess.run([self.cli, "unpack", "-", dst, "-pwd", "pw"], input=cut, capture_output=True)
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn("Truncated", result.stderr.decode("utf-8", "replace"))
+
     def test_verify_alignment_explicitly(self):
         """🔍 专门用于验证内存对齐的测试：发送特殊数值"""
         print("\n=== [Alignment Test] Sending Magic Numbers ===")